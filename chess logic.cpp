@@ -1,877 +1,6314 @@
-#include <iostream>
-#include <vector>
-#include <string>
-#include <map>
-#include <cctype>
-enum class PieceType {
-    EMPTY, PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING
-};
-enum class Color {
-    NONE, WHITE, BLACK
-};
-struct Piece {
-    PieceType type;
-    Color color;
-    
-    Piece() : type(PieceType::EMPTY), color(Color::NONE) {}
-    Piece(PieceType t, Color c) : type(t), color(c) {}
-    
-    char getSymbol() const {
-        char symbol = ' ';
-        switch (type) {
-            case PieceType::PAWN: symbol = 'P'; break;
-            case PieceType::KNIGHT: symbol = 'N'; break;
-            case PieceType::BISHOP: symbol = 'B'; break;
-            case PieceType::ROOK: symbol = 'R'; break;
-            case PieceType::QUEEN: symbol = 'Q'; break;
-            case PieceType::KING: symbol = 'K'; break;
-            default: return ' ';
-        }
-        return color == Color::WHITE ? symbol : tolower(symbol);
-    }
-};
-struct Position {
-    int row;
-    int col;
-    
-    Position() : row(0), col(0) {}
-    Position(int r, int c) : row(r), col(c) {}
-    
-    bool isValid() const {
-        return row >= 0 && row < 8 && col >= 0 && col < 8;
-    }
-    
-    std::string toAlgebraic() const {
-        if (!isValid()) return "invalid";
-        return std::string(1, 'a' + col) + std::string(1, '8' - row);
-    }
-    
-    static Position fromAlgebraic(const std::string& algebraic) {
-        if (algebraic.length() != 2) return Position(-1, -1);
-        int col = algebraic[0] - 'a';
-        int row = '8' - algebraic[1];
-        return Position(row, col);
-    }
-    
-    bool operator==(const Position& other) const {
-        return row == other.row && col == other.col;
-    }
-    
-    bool operator!=(const Position& other) const {
-        return !(*this == other);
-    }
-};
-struct Move {
-    Position from;
-    Position to;
-    PieceType promotion;
-    
-    Move() : from(), to(), promotion(PieceType::EMPTY) {}
-    Move(Position f, Position t) : from(f), to(t), promotion(PieceType::EMPTY) {}
-    Move(Position f, Position t, PieceType p) : from(f), to(t), promotion(p) {}
-    
-    std::string toString() const {
-        std::string result = from.toAlgebraic() + to.toAlgebraic();
-        if (promotion != PieceType::EMPTY) {
-            switch (promotion) {
-                case PieceType::QUEEN: result += 'q'; break;
-                case PieceType::ROOK: result += 'r'; break;
-                case PieceType::BISHOP: result += 'b'; break;
-                case PieceType::KNIGHT: result += 'n'; break;
-                default: break;
-            }
-        }
-        return result;
-    }
-};
-class ChessBoard {
-private:
-    std::vector<std::vector<Piece>> board;
-    Color currentPlayer;
-    bool whiteKingMoved;
-    bool blackKingMoved;
-    bool whiteQueenRookMoved;
-    bool whiteKingRookMoved;
-    bool blackQueenRookMoved;
-    bool blackKingRookMoved;
-    Position enPassantTarget;
-    
-public:
-    ChessBoard() : currentPlayer(Color::WHITE), 
-                  whiteKingMoved(false), blackKingMoved(false),
-                  whiteQueenRookMoved(false), whiteKingRookMoved(false),
-                  blackQueenRookMoved(false), blackKingRookMoved(false),
-                  enPassantTarget(Position(-1, -1)) {
-        //initialize the board
-        board.resize(8, std::vector<Piece>(8, Piece()));
-        resetBoard();
-    }
-    
-    void resetBoard() {
-        //pawns
-        for (int col = 0; col < 8; col++) {
-            board[1][col] = Piece(PieceType::PAWN, Color::BLACK);
-            board[6][col] = Piece(PieceType::PAWN, Color::WHITE);
-        }
-        
-        //rooks
-        board[0][0] = Piece(PieceType::ROOK, Color::BLACK);
-        board[0][7] = Piece(PieceType::ROOK, Color::BLACK);
-        board[7][0] = Piece(PieceType::ROOK, Color::WHITE);
-        board[7][7] = Piece(PieceType::ROOK, Color::WHITE);
-        
-        //knights
-        board[0][1] = Piece(PieceType::KNIGHT, Color::BLACK);
-        board[0][6] = Piece(PieceType::KNIGHT, Color::BLACK);
-        board[7][1] = Piece(PieceType::KNIGHT, Color::WHITE);
-        board[7][6] = Piece(PieceType::KNIGHT, Color::WHITE);
-        
-        //bishops
-        board[0][2] = Piece(PieceType::BISHOP, Color::BLACK);
-        board[0][5] = Piece(PieceType::BISHOP, Color::BLACK);
-        board[7][2] = Piece(PieceType::BISHOP, Color::WHITE);
-        board[7][5] = Piece(PieceType::BISHOP, Color::WHITE);
-        
-        //queens
-        board[0][3] = Piece(PieceType::QUEEN, Color::BLACK);
-        board[7][3] = Piece(PieceType::QUEEN, Color::WHITE);
-        
-        //kings
-        board[0][4] = Piece(PieceType::KING, Color::BLACK);
-        board[7][4] = Piece(PieceType::KING, Color::WHITE);
-        
-        //clear middle rows
-        for (int row = 2; row < 6; row++) {
-            for (int col = 0; col < 8; col++) {
-                board[row][col] = Piece();
-            }
-        }
-        
-        //reset state variables
-        currentPlayer = Color::WHITE;
-        whiteKingMoved = false;
-        blackKingMoved = false;
-        whiteQueenRookMoved = false;
-        whiteKingRookMoved = false;
-        blackQueenRookMoved = false;
-        blackKingRookMoved = false;
-        enPassantTarget = Position(-1, -1);
-    }
-    
-    void displayBoard() const {
-        std::cout << "  +---+---+---+---+---+---+---+---+" << std::endl;
-        for (int row = 0; row < 8; row++) {
-            std::cout << (8 - row) << " |";
-            for (int col = 0; col < 8; col++) {
-                std::cout << " " << board[row][col].getSymbol() << " |";
-            }
-            std::cout << std::endl << "  +---+---+---+---+---+---+---+---+" << std::endl;
-        }
-        std::cout << "    a   b   c   d   e   f   g   h  " << std::endl;
-    }
-    
-    Piece getPiece(const Position& pos) const {
-        if (!pos.isValid()) return Piece();
-        return board[pos.row][pos.col];
-    }
-    
-    void setPiece(const Position& pos, const Piece& piece) {
-        if (pos.isValid()) {
-            board[pos.row][pos.col] = piece;
-        }
-    }
-    
-    Color getCurrentPlayer() const {
-        return currentPlayer;
-    }
-    
-    void switchPlayer() {
-        currentPlayer = (currentPlayer == Color::WHITE) ? Color::BLACK : Color::WHITE;
-    }
-    
-    Position findKing(Color color) const {
-        for (int row = 0; row < 8; row++) {
-            for (int col = 0; col < 8; col++) {
-                Piece piece = board[row][col];
-                if (piece.type == PieceType::KING && piece.color == color) {
-                    return Position(row, col);
-                }
-            }
-        }
-        return Position(-1, -1); // King not foundz
-    }
-    
-    bool isCheck(Color color) const {
-        Position kingPos = findKing(color);
-        return isPositionUnderAttack(kingPos, color);
-    }
-    
-    bool isPositionUnderAttack(const Position& pos, Color defendingColor) const {
-        Color attackingColor = (defendingColor == Color::WHITE) ? Color::BLACK : Color::WHITE;
-        
-        //check for pawn attacks
-        int pawnRow = (defendingColor == Color::WHITE) ? -1 : 1;
-        if ((pos.row + pawnRow >= 0 && pos.row + pawnRow < 8) && 
-            (pos.col - 1 >= 0 && board[pos.row + pawnRow][pos.col - 1].type == PieceType::PAWN && 
-             board[pos.row + pawnRow][pos.col - 1].color == attackingColor)) {
-            return true;
-        }
-        if ((pos.row + pawnRow >= 0 && pos.row + pawnRow < 8) && 
-            (pos.col + 1 < 8 && board[pos.row + pawnRow][pos.col + 1].type == PieceType::PAWN && 
-             board[pos.row + pawnRow][pos.col + 1].color == attackingColor)) {
-            return true;
-        }
-        
-        //knight moves
-        std::vector<std::pair<int, int>> knightMoves = {
-            {-2, -1}, {-2, 1}, {-1, -2}, {-1, 2}, {1, -2}, {1, 2}, {2, -1}, {2, 1}
-        };
-        for (const auto& move : knightMoves) {
-            int newRow = pos.row + move.first;
-            int newCol = pos.col + move.second;
-            if (newRow >= 0 && newRow < 8 && newCol >= 0 && newCol < 8) {
-                Piece piece = board[newRow][newCol];
-                if (piece.type == PieceType::KNIGHT && piece.color == attackingColor) {
-                    return true;
-                }
-            }
-        }
-        
-        //directions for sliding pieces
-        std::vector<std::pair<int, int>> directions = {
-            {-1, 0}, {1, 0}, {0, -1}, {0, 1}, // Rook/Queen
-            {-1, -1}, {-1, 1}, {1, -1}, {1, 1} // Bishop/Queen
-        };
-        
-        for (const auto& dir : directions) {
-            int dr = dir.first;
-            int dc = dir.second;
-            int newRow = pos.row + dr;
-            int newCol = pos.col + dc;
-            
-            while (newRow >= 0 && newRow < 8 && newCol >= 0 && newCol < 8) {
-                Piece piece = board[newRow][newCol];
-                if (piece.type != PieceType::EMPTY) {
-                    if (piece.color == attackingColor) {
-                        bool isRookMove = (dr == 0 || dc == 0);
-                        bool isBishopMove = (abs(dr) == abs(dc));
-                        
-                        if ((isRookMove && (piece.type == PieceType::ROOK || piece.type == PieceType::QUEEN)) ||
-                            (isBishopMove && (piece.type == PieceType::BISHOP || piece.type == PieceType::QUEEN))) {
-                            return true;
-                        }
-                    }
-                    break; // Stop in this direction after finding any piece
-                }
-                newRow += dr;
-                newCol += dc;
-            }
-        }
-        
-        //king attacks
-        std::vector<std::pair<int, int>> kingMoves = {
-            {-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1}
-        };
-        for (const auto& move : kingMoves) {
-            int newRow = pos.row + move.first;
-            int newCol = pos.col + move.second;
-            if (newRow >= 0 && newRow < 8 && newCol >= 0 && newCol < 8) {
-                Piece piece = board[newRow][newCol];
-                if (piece.type == PieceType::KING && piece.color == attackingColor) {
-                    return true;
-                }
-            }
-        }
-        
-        return false;
-    }
-    
-    bool makeMove(const Move& move) {
-        if (!move.from.isValid() || !move.to.isValid()) {
-            return false;
-        }
-        Piece piece = getPiece(move.from);
-        
-        //check if the piece belongs to the current player
-        if (piece.color != currentPlayer) {
-            return false;
-        }
-        //check if the move is valid for this piece
-        if (!isValidMove(move)) {
-            return false;
-        }
-        
-        //save the state before the move for check validation
-        Piece capturedPiece = getPiece(move.to);
-        bool wasKingMoved = (currentPlayer == Color::WHITE) ? whiteKingMoved : blackKingMoved;
-        bool wasQueenRookMoved = (currentPlayer == Color::WHITE) ? whiteQueenRookMoved : blackQueenRookMoved;
-        bool wasKingRookMoved = (currentPlayer == Color::WHITE) ? whiteKingRookMoved : blackKingRookMoved;
-        
-        //execute move
-        Position oldEnPassantTarget = enPassantTarget;
-        executeMove(move);
-        
-        //check if move puts or leaves the player's king in check
-        if (isCheck(currentPlayer)) {
-            // Undo the move
-            undoMove(move, capturedPiece, wasKingMoved, wasQueenRookMoved, wasKingRookMoved, oldEnPassantTarget);
-            return false;
-        }
-        switchPlayer();
-        return true;
-    }
-    void executeMove(const Move& move) {
-        Piece piece = getPiece(move.from);
-        Piece capturedPiece = getPiece(move.to);
-        
-        //update castling flags
-        if (piece.type == PieceType::KING) {
-            if (piece.color == Color::WHITE) {
-                whiteKingMoved = true;
-            } else {
-                blackKingMoved = true;
-            }
-            
-            //handle castling move
-            if (abs(move.to.col - move.from.col) == 2) {
-                // King-side castling
-                if (move.to.col == 6) {
-                    // Move the rook
-                    Piece rook = getPiece(Position(move.from.row, 7));
-                    setPiece(Position(move.from.row, 5), rook);
-                    setPiece(Position(move.from.row, 7), Piece());
-                }
-                //queen-side castling
-                else if (move.to.col == 2) {
-                    // Move the rook
-                    Piece rook = getPiece(Position(move.from.row, 0));
-                    setPiece(Position(move.from.row, 3), rook);
-                    setPiece(Position(move.from.row, 0), Piece());
-                }
-            }
-        }
-        
-        //update rook moved flags
-        if (piece.type == PieceType::ROOK) {
-            if (piece.color == Color::WHITE) {
-                if (move.from == Position(7, 0)) {
-                    whiteQueenRookMoved = true;
-                } else if (move.from == Position(7, 7)) {
-                    whiteKingRookMoved = true;
-                }
-            } else {
-                if (move.from == Position(0, 0)) {
-                    blackQueenRookMoved = true;
-                } else if (move.from == Position(0, 7)) {
-                    blackKingRookMoved = true;
-                }
-            }
-        }
-        
-        // handle en passant capture
-        if (piece.type == PieceType::PAWN && move.to == enPassantTarget) {
-            int captureRow = (piece.color == Color::WHITE) ? move.to.row + 1 : move.to.row - 1;
-            setPiece(Position(captureRow, move.to.col), Piece());
-        }
-        
-        //new en passant target if this is a double pawn move
-        enPassantTarget = Position(-1, -1); // Reset en passant target
-        if (piece.type == PieceType::PAWN && abs(move.to.row - move.from.row) == 2) {
-            int targetRow = (move.from.row + move.to.row) / 2;
-            enPassantTarget = Position(targetRow, move.from.col);
-        }
-        if (piece.type == PieceType::PAWN && (move.to.row == 0 || move.to.row == 7)) {
-            if (move.promotion != PieceType::EMPTY) {
-                piece.type = move.promotion;
-            } else {
-                piece.type = PieceType::QUEEN; // Default promotion to queen
-            }
-        }
-        setPiece(move.to, piece);
-        setPiece(move.from, Piece());
-    }
-    
-    void undoMove(const Move& move, const Piece& capturedPiece, bool wasKingMoved, 
-                 bool wasQueenRookMoved, bool wasKingRookMoved, const Position& oldEnPassantTarget) {
-        Piece piece = getPiece(move.to);
-        
-        //restore the moved piece to its original position
-        setPiece(move.from, piece);
-        setPiece(move.to, capturedPiece);
-        
-        //restore castling flags
-        if (currentPlayer == Color::WHITE) {
-            whiteKingMoved = wasKingMoved;
-            whiteQueenRookMoved = wasQueenRookMoved;
-            whiteKingRookMoved = wasKingRookMoved;
-        } else {
-            blackKingMoved = wasKingMoved;
-            blackQueenRookMoved = wasQueenRookMoved;
-            blackKingRookMoved = wasKingRookMoved;
-        }
-        
-        //undo castling move if needed
-        if (piece.type == PieceType::KING && abs(move.to.col - move.from.col) == 2) {
-            // King-side castling
-            if (move.to.col == 6) {
-                Piece rook = getPiece(Position(move.from.row, 5));
-                setPiece(Position(move.from.row, 7), rook);
-                setPiece(Position(move.from.row, 5), Piece());
-            }
-            // Queen-side castling
-            else if (move.to.col == 2) {
-                Piece rook = getPiece(Position(move.from.row, 3));
-                setPiece(Position(move.from.row, 0), rook);
-                setPiece(Position(move.from.row, 3), Piece());
-            }
-        }
-        
-        //rstore en passant target
-        enPassantTarget = oldEnPassantTarget;
-        
-        //if this was an en passant capture, restore the captured pawn
-        if (piece.type == PieceType::PAWN && move.to == oldEnPassantTarget) {
-            int captureRow = (piece.color == Color::WHITE) ? move.to.row + 1 : move.to.row - 1;
-            setPiece(Position(captureRow, move.to.col), 
-                    Piece(PieceType::PAWN, (piece.color == Color::WHITE) ? Color::BLACK : Color::WHITE));
-        }
-    }
-    
-    bool isValidMove(const Move& move) const {
-        Piece piece = getPiece(move.from);
-        Piece targetPiece = getPiece(move.to);
-        
-        //can't capture own piece
-        if (targetPiece.type != PieceType::EMPTY && targetPiece.color == piece.color) {
-            return false;
-        }
-        
-        switch (piece.type) {
-            case PieceType::PAWN:
-                return isValidPawnMove(move);
-            case PieceType::KNIGHT:
-                return isValidKnightMove(move);
-            case PieceType::BISHOP:
-                return isValidBishopMove(move);
-            case PieceType::ROOK:
-                return isValidRookMove(move);
-            case PieceType::QUEEN:
-                return isValidQueenMove(move);
-            case PieceType::KING:
-                return isValidKingMove(move);
-            default:
-                return false;
-        }
-    }
-    
-    bool isValidPawnMove(const Move& move) const {
-        Piece pawn = getPiece(move.from);
-        Piece targetPiece = getPiece(move.to);
-        
-        int direction = (pawn.color == Color::WHITE) ? -1 : 1;
-        int startRow = (pawn.color == Color::WHITE) ? 6 : 1;
-        
-        //regular move forward
-        if (move.from.col == move.to.col) {
-            // Single step forward
-            if (move.to.row == move.from.row + direction) {
-                return targetPiece.type == PieceType::EMPTY;
-            }
-            //double step from starting position
-            if (move.from.row == startRow && move.to.row == move.from.row + 2 * direction) {
-                Position intermediate(move.from.row + direction, move.from.col);
-                return targetPiece.type == PieceType::EMPTY && 
-                       getPiece(intermediate).type == PieceType::EMPTY;
-            }
-        }
-        else if (abs(move.to.col - move.from.col) == 1 && move.to.row == move.from.row + direction) {
-            //regular capture
-            if (targetPiece.type != PieceType::EMPTY && targetPiece.color != pawn.color) {
-                return true;
-            }
-            //en passant capture
-            if (targetPiece.type == PieceType::EMPTY && move.to == enPassantTarget) {
-                return true;
-            }
-        }
-        
-        return false;
-    }
-    
-    bool isValidKnightMove(const Move& move) const {
-        int rowDiff = abs(move.to.row - move.from.row);
-        int colDiff = abs(move.to.col - move.from.col);
-        
-        return (rowDiff == 2 && colDiff == 1) || (rowDiff == 1 && colDiff == 2);
-    }
-    
-    bool isValidBishopMove(const Move& move) const {
-        int rowDiff = abs(move.to.row - move.from.row);
-        int colDiff = abs(move.to.col - move.from.col);
-        
-        if (rowDiff != colDiff) {
-            return false;
-        }
-        
-        //check if the path is clear
-        int rowStep = (move.to.row > move.from.row) ? 1 : -1;
-        int colStep = (move.to.col > move.from.col) ? 1 : -1;
-        
-        for (int i = 1; i < rowDiff; i++) {
-            Position pos(move.from.row + i * rowStep, move.from.col + i * colStep);
-            if (getPiece(pos).type != PieceType::EMPTY) {
-                return false;
-            }
-        }
-        
-        return true;
-    }
-    
-    bool isValidRookMove(const Move& move) const {
-        int rowDiff = abs(move.to.row - move.from.row);
-        int colDiff = abs(move.to.col - move.from.col);
-        
-        if (rowDiff != 0 && colDiff != 0) {
-            return false;
-        }
-        
-        //Check if the path is clear
-        if (rowDiff == 0) {
-            int step = (move.to.col > move.from.col) ? 1 : -1;
-            for (int col = move.from.col + step; col != move.to.col; col += step) {
-                Position pos(move.from.row, col);
-                if (getPiece(pos).type != PieceType::EMPTY) {
-                    return false;
-                }
-            }
-        } else {
-            int step = (move.to.row > move.from.row) ? 1 : -1;
-            for (int row = move.from.row + step; row != move.to.row; row += step) {
-                Position pos(row, move.from.col);
-                if (getPiece(pos).type != PieceType::EMPTY) {
-                    return false;
-                }
-            }
-        }
-        
-        return true;
-    }
-    
-    bool isValidQueenMove(const Move& move) const {
-        return isValidBishopMove(move) || isValidRookMove(move);
-    }
-    
-    bool isValidKingMove(const Move& move) const {
-        Piece king = getPiece(move.from);
-        int rowDiff = abs(move.to.row - move.from.row);
-        int colDiff = abs(move.to.col - move.from.col);
-        
-        //Normal king move
-        if (rowDiff <= 1 && colDiff <= 1) {
-            return true;
-        }
-        
-        //castling
-        if (rowDiff == 0 && colDiff == 2) {
-            // Check if the king has already moved
-            if ((king.color == Color::WHITE && whiteKingMoved) || 
-                (king.color == Color::BLACK && blackKingMoved)) {
-                return false;
-            }
-            if (isCheck(king.color)) {
-                return false;
-            }
-          
-            int row = move.from.row;
-            
-            //king-side castling
-            if (move.to.col == 6) {
-                //check if the rook has moved
-                if ((king.color == Color::WHITE && whiteKingRookMoved) ||
-                    (king.color == Color::BLACK && blackKingRookMoved)) {
-                    return false;
-                }
-                
-                // Check if the path is clear
-                if (getPiece(Position(row, 5)).type != PieceType::EMPTY || 
-                    getPiece(Position(row, 6)).type != PieceType::EMPTY) {
-                    return false;
-                }
-                
-                //check if the squares the king passes through are under attack
-                if (isPositionUnderAttack(Position(row, 5), king.color)) {
-                    return false;
-                }
-                
-                //check ifrook is in place
-                Piece rook = getPiece(Position(row, 7));
-                return rook.type == PieceType::ROOK && rook.color == king.color;
-            }
-            //queen-side castling
-            else if (move.to.col == 2) {
-                // Check if the rook has moved
-                if ((king.color == Color::WHITE && whiteQueenRookMoved) ||
-                    (king.color == Color::BLACK && blackQueenRookMoved)) {
-                    return false;
-                }
-                if (getPiece(Position(row, 1)).type != PieceType::EMPTY || 
-                    getPiece(Position(row, 2)).type != PieceType::EMPTY ||
-                    getPiece(Position(row, 3)).type != PieceType::EMPTY) {
-                    return false;
-                }
-                if (isPositionUnderAttack(Position(row, 3), king.color)) {
-                    return false;
-                }
-                Piece rook = getPiece(Position(row, 0));
-                return rook.type == PieceType::ROOK && rook.color == king.color;
-            }
-        }
-        
-        return false;
-    }
-    
-    std::vector<Move> getAllLegalMoves() const {
-        std::vector<Move> legalMoves;
-        
-        for (int fromRow = 0; fromRow < 8; fromRow++) {
-            for (int fromCol = 0; fromCol < 8; fromCol++) {
-                Position from(fromRow, fromCol);
-                Piece piece = getPiece(from);
-                
-                if (piece.type != PieceType::EMPTY && piece.color == currentPlayer) {
-                    for (int toRow = 0; toRow < 8; toRow++) {
-                        for (int toCol = 0; toCol < 8; toCol++) {
-                            Position to(toRow, toCol);
-                            Move move(from, to);
-                            
-                            //check if the move is valid without making it
-                            if (isValidMove(move)) {
-                                //save the state before the move
-                                Piece capturedPiece = getPiece(to);
-                                bool wasKingMoved = (currentPlayer == Color::WHITE) ? whiteKingMoved : blackKingMoved;
-                                bool wasQueenRookMoved = (currentPlayer == Color::WHITE) ? whiteQueenRookMoved : blackQueenRookMoved;
-                                bool wasKingRookMoved = (currentPlayer == Color::WHITE) ? whiteKingRookMoved : blackKingRookMoved;
-                                Position oldEnPassantTarget = enPassantTarget;
-                                
-                                const_cast<ChessBoard*>(this)->executeMove(move);
-                                
-                                //check if the move leaves the king in check
-                                bool isLegal = !const_cast<ChessBoard*>(this)->isCheck(currentPlayer);
-                                
-                                const_cast<ChessBoard*>(this)->undoMove(move, capturedPiece, wasKingMoved, 
-                                                                      wasQueenRookMoved, wasKingRookMoved, 
-                                                                      oldEnPassantTarget);
-                                
-                                if (isLegal) {
-                                    //add promotions for pawns reaching the last rank
-                                    if (piece.type == PieceType::PAWN && (to.row == 0 || to.row == 7)) {
-                                        legalMoves.push_back(Move(from, to, PieceType::QUEEN));
-                                        legalMoves.push_back(Move(from, to, PieceType::ROOK));
-                                        legalMoves.push_back(Move(from, to, PieceType::BISHOP));
-                                        legalMoves.push_back(Move(from, to, PieceType::KNIGHT));
-                                    } else {
-                                        legalMoves.push_back(move);
-                                    }
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-        }
-        return legalMoves;
-    }
-    
-    bool isCheckmate() const {
-        return isCheck(currentPlayer) && getAllLegalMoves().empty();
-    }
-    
-    bool isStalemate() const {
-        return !isCheck(currentPlayer) && getAllLegalMoves().empty();
-    }
-    bool isDraw() const {
-        // Stalemate
-        if (isStalemate()) {
-            return true;
-        }
-        bool insufficientMaterial = true;
-        int bishopsWhite = 0;
-        int bishopsBlack = 0;
-        int knightsWhite = 0;
-        int knightsBlack = 0;
-        int otherPieces = 0;
-        
-        for (int row = 0; row < 8; row++) {
-            for (int col = 0; col < 8; col++) {
-                Piece piece = board[row][col];
-                if (piece.type == PieceType::EMPTY) continue;
-                
-                if (piece.type == PieceType::PAWN || piece.type == PieceType::ROOK || piece.type == PieceType::QUEEN) {
-                    insufficientMaterial = false;
-                    break;
-                } else if (piece.type == PieceType::BISHOP) {
-                    if (piece.color == Color::WHITE) {
-                        bishopsWhite++;
-                    } else {
-                        bishopsBlack++;
-                    }
-                } else if (piece.type == PieceType::KNIGHT) {
-                    if (piece.color == Color::WHITE) {
-                        knightsWhite++;
-                    } else {
-                        knightsBlack++;
-                    }
-                }
-            }
-            
-            if (!insufficientMaterial) break;
-        }
-        
-        otherPieces = bishopsWhite + bishopsBlack + knightsWhite + knightsBlack;
-        
-        // King vs. King
-        if (otherPieces == 0) {
-            return true;
-        }
-        
-        // King and Bishop vs. King
-        if ((bishopsWhite == 1 && bishopsBlack == 0 && knightsWhite == 0 && knightsBlack == 0) ||
-            (bishopsWhite == 0 && bishopsBlack == 1 && knightsWhite == 0 && knightsBlack == 0)) {
-            return true;
-        }
-        
-        // King and Knight vs. King
-        if ((knightsWhite == 1 && knightsBlack == 0 && bishopsWhite == 0 && bishopsBlack == 0) ||
-            (knightsWhite == 0 && knightsBlack == 1 && bishopsWhite == 0 && bishopsBlack == 0)) {
-            return true;
-        }
-        
-        return false;
-    }
-    
-    std::string getGameState() const {
-        if (isCheckmate()) {
-            return (currentPlayer == Color::WHITE) ? "Black wins by checkmate" : "White wins by checkmate";
-        } else if (isStalemate()) {
-            return "Draw by stalemate";
-        } else if (isDraw()) {
-            return "Draw by insufficient material";
-        } else if (isCheck(currentPlayer)) {
-            return (currentPlayer == Color::WHITE) ? "White is in check" : "Black is in check";
-        } else {
-            return (currentPlayer == Color::WHITE) ? "White to move" : "Black to move";
-        }
-    }
-};
-
-//game controller class
-class ChessGame {
-private:
-    ChessBoard board;
-    std::vector<Move> moveHistory;
-    
-public:
-    ChessGame() : board() {}
-    
-    void start() {
-        board.resetBoard();
-        moveHistory.clear();
-    }
-    
-    void printBoard() const {
-        board.displayBoard();
-        std::cout << board.getGameState() << std::endl;
-    }
-    
-    bool makeMove(const std::string& moveStr) {
-        if (moveStr.length() < 4) {
-            std::cout << "Invalid move format. Please use format like 'e2e4' or 'e7e8q' for promotion." << std::endl;
-            return false;
-        }
-        
-        Position from = Position::fromAlgebraic(moveStr.substr(0, 2));
-        Position to = Position::fromAlgebraic(moveStr.substr(2, 2));
-        
-        PieceType promotion = PieceType::EMPTY;
-        if (moveStr.length() >= 5) {
-            char promotionChar = std::tolower(moveStr[4]);
-            switch (promotionChar) {
-                case 'q': promotion = PieceType::QUEEN; break;
-                case 'r': promotion = PieceType::ROOK; break;
-                case 'b': promotion = PieceType::BISHOP; break;
-                case 'n': promotion = PieceType::KNIGHT; break;
-                default: 
-                    std::cout << "Invalid promotion piece. Use q, r, b, or n." << std::endl;
-                    return false;
-            }
-        }
-        
-        Move move(from, to, promotion);
-        
-        if (board.makeMove(move)) {
-            moveHistory.push_back(move);
-            return true;
-        } else {
-            std::cout << "Invalid move." << std::endl;
-            return false;
-        }
-    }
-    
-    bool isGameOver() const {
-        return board.isCheckmate() || board.isStalemate() || board.isDraw();
-    }
-    
-    std::string getResult() const {
-        return board.getGameState();
-    }
-    
-    Color getCurrentPlayer() const {
-        return board.getCurrentPlayer();
-    }
-    
-    std::vector<Move> getLegalMoves() const {
-        return board.getAllLegalMoves();
-    }
-    
-    void printLegalMoves() const {
-        std::vector<Move> moves = getLegalMoves();
-        std::cout << "Legal moves: ";
-        for (const auto& move : moves) {
-            std::cout << move.toString() << " ";
-        }
-        std::cout << std::endl;
-    }
-    
-    std::vector<Move> getMoveHistory() const {
-        return moveHistory;
-    }
-};
-
-//main function
-int main() {
-    ChessGame game;
-    game.start();
-    
-    std::string input;
-    while (!game.isGameOver()) {
-        game.printBoard();
-        
-        std::cout << "Enter move (e.g., 'e2e4') or 'q' to quit, 'l' for legal moves: ";
-        std::cin >> input;
-        
-        if (input == "q") {
-            break;
-        } else if (input == "l") {
-            game.printLegalMoves();
-        } else {
-            game.makeMove(input);
-        }
-    }
-    
-    if (game.isGameOver()) {
-        game.printBoard();
-        std::cout << "Game over: " << game.getResult() << std::endl;
-    }
-    
-    return 0;
-}
\ No newline at end of file
+#include <iostream>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <map>
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <cassert>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <new>
+#include <climits>
+#include <fstream>
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <malloc.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+#if defined(CHESS_USE_PEXT) && defined(__BMI2__)
+#include <immintrin.h>
+#endif
+enum class PieceType : uint8_t {
+    EMPTY, PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING
+};
+enum class Color : uint8_t {
+    NONE, WHITE, BLACK
+};
+struct Piece {
+    PieceType type;
+    Color color;
+    
+    Piece() : type(PieceType::EMPTY), color(Color::NONE) {}
+    Piece(PieceType t, Color c) : type(t), color(c) {}
+    
+    char getSymbol() const {
+        char symbol = ' ';
+        switch (type) {
+            case PieceType::PAWN: symbol = 'P'; break;
+            case PieceType::KNIGHT: symbol = 'N'; break;
+            case PieceType::BISHOP: symbol = 'B'; break;
+            case PieceType::ROOK: symbol = 'R'; break;
+            case PieceType::QUEEN: symbol = 'Q'; break;
+            case PieceType::KING: symbol = 'K'; break;
+            default: return ' ';
+        }
+        return color == Color::WHITE ? symbol : tolower(symbol);
+    }
+};
+struct Position {
+    int row;
+    int col;
+    
+    Position() : row(0), col(0) {}
+    Position(int r, int c) : row(r), col(c) {}
+    
+    bool isValid() const {
+        return row >= 0 && row < 8 && col >= 0 && col < 8;
+    }
+    
+    std::string toAlgebraic() const {
+        if (!isValid()) return "invalid";
+        return std::string(1, 'a' + col) + std::string(1, '8' - row);
+    }
+    
+    static Position fromAlgebraic(const std::string& algebraic) {
+        if (algebraic.length() != 2) return Position(-1, -1);
+        int col = algebraic[0] - 'a';
+        int row = '8' - algebraic[1];
+        return Position(row, col);
+    }
+    
+    bool operator==(const Position& other) const {
+        return row == other.row && col == other.col;
+    }
+    
+    bool operator!=(const Position& other) const {
+        return !(*this == other);
+    }
+};
+
+//square numbering shared by moves and bitboards: a1 = 0, b1 = 1 ... h8 = 63
+inline int toSquare(const Position& pos) {
+    return (7 - pos.row) * 8 + pos.col;
+}
+
+inline Position fromSquare(int sq) {
+    return Position(7 - (sq >> 3), sq & 7);
+}
+
+//a move packed into 16 bits: from square in bits 0-5, to square in bits 6-11, promotion piece
+//(knight to queen) in bits 12-13 and the move kind in bits 14-15. The all-zero value is the null move.
+struct Move {
+    enum Kind : uint16_t {
+        NORMAL = 0, PROMOTION = 1 << 14, EN_PASSANT = 2 << 14, CASTLING = 3 << 14
+    };
+    
+    Move() : data(0) {}
+    Move(int fromSq, int toSq, Kind kind = NORMAL, PieceType promotion = PieceType::KNIGHT)
+        : data(static_cast<uint16_t>(fromSq | (toSq << 6) | kind |
+                                     ((static_cast<int>(promotion) - static_cast<int>(PieceType::KNIGHT)) << 12))) {}
+    
+    //conversion from board coordinates; castling and en passant are only told apart by matching
+    //against the generated moves, see ChessBoard::resolveMove
+    Move(Position f, Position t, PieceType p = PieceType::EMPTY)
+        : Move(toSquare(f), toSquare(t), (p == PieceType::EMPTY) ? NORMAL : PROMOTION,
+               (p == PieceType::EMPTY) ? PieceType::KNIGHT : p) {}
+    
+    static Move fromRaw(uint16_t raw) {
+        Move move;
+        move.data = raw;
+        return move;
+    }
+    
+    uint16_t raw() const {
+        return data;
+    }
+    
+    int fromSq() const {
+        return data & 63;
+    }
+    
+    int toSq() const {
+        return (data >> 6) & 63;
+    }
+    
+    Kind kind() const {
+        return static_cast<Kind>(data & (3 << 14));
+    }
+    
+    Position from() const {
+        return fromSquare(fromSq());
+    }
+    
+    Position to() const {
+        return fromSquare(toSq());
+    }
+    
+    PieceType promotion() const {
+        return (kind() == PROMOTION) ? static_cast<PieceType>(((data >> 12) & 3) + static_cast<int>(PieceType::KNIGHT))
+                                     : PieceType::EMPTY;
+    }
+    
+    bool isNull() const {
+        return data == 0;
+    }
+    
+    bool operator==(const Move& other) const {
+        return data == other.data;
+    }
+    
+    bool operator!=(const Move& other) const {
+        return data != other.data;
+    }
+    
+    std::string toString() const {
+        std::string result = from().toAlgebraic() + to().toAlgebraic();
+        switch (promotion()) {
+            case PieceType::QUEEN: result += 'q'; break;
+            case PieceType::ROOK: result += 'r'; break;
+            case PieceType::BISHOP: result += 'b'; break;
+            case PieceType::KNIGHT: result += 'n'; break;
+            default: break;
+        }
+        return result;
+    }
+    
+private:
+    uint16_t data;
+};
+static_assert(sizeof(Move) == 2, "moves are stored packed in tables and histories");
+
+//fixed-capacity move buffer filled by the move generators
+struct MoveList {
+    static const int CAPACITY = 256; //comfortably above the 218 moves of the richest legal position
+    Move moves[CAPACITY];
+    int count;
+    
+    MoveList() : count(0) {}
+    
+    void add(const Move& move) {
+        moves[count++] = move;
+    }
+    
+    void clear() {
+        count = 0;
+    }
+    
+    int size() const {
+        return count;
+    }
+    
+    bool empty() const {
+        return count == 0;
+    }
+    
+    const Move& operator[](int index) const {
+        return moves[index];
+    }
+    
+    const Move* begin() const {
+        return moves;
+    }
+    
+    const Move* end() const {
+        return moves + count;
+    }
+};
+
+//bitboards: one bit per square, a1 = bit 0 ... h8 = bit 63
+typedef uint64_t Bitboard;
+
+constexpr Bitboard squareBB(int sq) {
+    return 1ULL << sq;
+}
+
+inline int popCount(Bitboard b) {
+#ifdef _MSC_VER
+    return static_cast<int>(__popcnt64(b));
+#else
+    return __builtin_popcountll(b);
+#endif
+}
+
+inline int lsb(Bitboard b) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, b);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(b);
+#endif
+}
+
+inline int popLsb(Bitboard& b) {
+    int sq = lsb(b);
+    b &= b - 1;
+    return sq;
+}
+
+inline Color opposite(Color color) {
+    return (color == Color::WHITE) ? Color::BLACK : Color::WHITE;
+}
+
+//walk one ray from sq until the edge or the first occupied square (inclusive)
+constexpr Bitboard rayAttacks(int sq, Bitboard occupied, int fileStep, int rankStep) {
+    Bitboard attacks = 0;
+    int file = (sq & 7) + fileStep;
+    int rank = (sq >> 3) + rankStep;
+    while (file >= 0 && file < 8 && rank >= 0 && rank < 8) {
+        Bitboard bit = squareBB(rank * 8 + file);
+        attacks |= bit;
+        if (occupied & bit) break;
+        file += fileStep;
+        rank += rankStep;
+    }
+    return attacks;
+}
+
+constexpr Bitboard bishopRayAttacks(int sq, Bitboard occupied) {
+    return rayAttacks(sq, occupied, 1, 1) | rayAttacks(sq, occupied, 1, -1) |
+           rayAttacks(sq, occupied, -1, 1) | rayAttacks(sq, occupied, -1, -1);
+}
+
+constexpr Bitboard rookRayAttacks(int sq, Bitboard occupied) {
+    return rayAttacks(sq, occupied, 1, 0) | rayAttacks(sq, occupied, -1, 0) |
+           rayAttacks(sq, occupied, 0, 1) | rayAttacks(sq, occupied, 0, -1);
+}
+
+//xorshift64* generator, deterministic so every run finds the same magics
+struct PRNG {
+    uint64_t state;
+    
+    explicit PRNG(uint64_t seed) : state(seed) {}
+    
+    uint64_t rand64() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 2685821657736338717ULL;
+    }
+    
+    //few set bits make good magic candidates
+    uint64_t sparseRand() {
+        return rand64() & rand64() & rand64();
+    }
+};
+
+//per-square lookup into a shared attack table: index = ((occupied & mask) * magic) >> shift,
+//or pext(occupied, mask) when built with CHESS_USE_PEXT on a BMI2 target
+struct Magic {
+    Bitboard mask;
+    Bitboard magic;
+    Bitboard* attacks;
+    int shift;
+    
+    unsigned index(Bitboard occupied) const {
+#if defined(CHESS_USE_PEXT) && defined(__BMI2__)
+        return static_cast<unsigned>(_pext_u64(occupied, mask));
+#else
+        return static_cast<unsigned>(((occupied & mask) * magic) >> shift);
+#endif
+    }
+};
+
+//magic multipliers found offline with SliderTables::findMagic, so startup only fills the tables
+static const uint64_t rookMagicNumbers[64] = {
+    0x0A80004000801220ULL, 0x8040004010002008ULL, 0x2080200010008008ULL, 0x1100100008210004ULL,
+    0xC200209084020008ULL, 0x2100010004000208ULL, 0x0400081000822421ULL, 0x0200010422048844ULL,
+    0x0800800080400024ULL, 0x0001402000401000ULL, 0x3000801000802001ULL, 0x4400800800100083ULL,
+    0x0904802402480080ULL, 0x4040800400020080ULL, 0x0018808042000100ULL, 0x4040800080004100ULL,
+    0x0040048001458024ULL, 0x00A0004000205000ULL, 0x3100808010002000ULL, 0x4825010010000820ULL,
+    0x5004808008000401ULL, 0x2024818004000A00ULL, 0x0005808002000100ULL, 0x2100060004806104ULL,
+    0x0080400880008421ULL, 0x4062220600410280ULL, 0x010A004A00108022ULL, 0x0000100080080080ULL,
+    0x0021000500080010ULL, 0x0044000202001008ULL, 0x0000100400080102ULL, 0xC020128200040545ULL,
+    0x0080002000400040ULL, 0x0000804000802004ULL, 0x0000120022004080ULL, 0x010A386103001001ULL,
+    0x9010080080800400ULL, 0x8440020080800400ULL, 0x0004228824001001ULL, 0x000000490A000084ULL,
+    0x0080002000504000ULL, 0x200020005000C000ULL, 0x0012088020420010ULL, 0x0010010080080800ULL,
+    0x0085001008010004ULL, 0x0002000204008080ULL, 0x0040413002040008ULL, 0x0000304081020004ULL,
+    0x0080204000800080ULL, 0x3008804000290100ULL, 0x1010100080200080ULL, 0x2008100208028080ULL,
+    0x5000850800910100ULL, 0x8402019004680200ULL, 0x0120911028020400ULL, 0x0000008044010200ULL,
+    0x0020850200244012ULL, 0x0020850200244012ULL, 0x0000102001040841ULL, 0x140900040A100021ULL,
+    0x000200282410A102ULL, 0x000200282410A102ULL, 0x000200282410A102ULL, 0x4048240043802106ULL
+};
+static const uint64_t bishopMagicNumbers[64] = {
+    0x9060124418008010ULL, 0x0020010250810120ULL, 0x2010010220280081ULL, 0x002806004050C040ULL,
+    0x0002021018000000ULL, 0x2001112010000400ULL, 0x0881010120218080ULL, 0x1030820110010500ULL,
+    0x0000120222042400ULL, 0x2000020404040044ULL, 0x8000480094208000ULL, 0x0003422A02000001ULL,
+    0x000A220210100040ULL, 0x8004820202226000ULL, 0x0018234854100800ULL, 0x0100004042101040ULL,
+    0x0004001004082820ULL, 0x0010000810010048ULL, 0x1014004208081300ULL, 0x2080818802044202ULL,
+    0x0040880C00A00100ULL, 0x0080400200522010ULL, 0x0001000188180B04ULL, 0x0080249202020204ULL,
+    0x1004400004100410ULL, 0x00013100A0022206ULL, 0x2148500001040080ULL, 0x4241080011004300ULL,
+    0x4020848004002000ULL, 0x10101380D1004100ULL, 0x0008004422020284ULL, 0x01010A1041008080ULL,
+    0x0808080400082121ULL, 0x0808080400082121ULL, 0x0091128200100C00ULL, 0x0202200802010104ULL,
+    0x8C0A020200440085ULL, 0x01A0008080B10040ULL, 0x0889520080122800ULL, 0x100902022202010AULL,
+    0x04081A0816002000ULL, 0x0000681208005000ULL, 0x8170840041008802ULL, 0x0A00004200810805ULL,
+    0x0830404408210100ULL, 0x2602208106006102ULL, 0x1048300680802628ULL, 0x2602208106006102ULL,
+    0x0602010120110040ULL, 0x0941010801043000ULL, 0x000040440A210428ULL, 0x0008240020880021ULL,
+    0x0400002012048200ULL, 0x00AC102001210220ULL, 0x0220021002009900ULL, 0x84440C080A013080ULL,
+    0x0001008044200440ULL, 0x0004C04410841000ULL, 0x2000500104011130ULL, 0x1A0C010011C20229ULL,
+    0x0044800112202200ULL, 0x0434804908100424ULL, 0x0300404822C08200ULL, 0x48081010008A2A80ULL
+};
+
+//rook and bishop attacks for every square and blocker set, built once at startup
+struct SliderTables {
+    Magic rookMagics[64];
+    Magic bishopMagics[64];
+    Bitboard rookTable[102400];
+    Bitboard bishopTable[5248];
+    double initMillis; //time spent building the tables, reported by the benchmarks
+    
+    SliderTables() {
+        auto start = std::chrono::steady_clock::now();
+        initMagics(rookTable, rookMagics, rookMagicNumbers, rookRayAttacks);
+        initMagics(bishopTable, bishopMagics, bishopMagicNumbers, bishopRayAttacks);
+        initMillis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    
+    static void initMagics(Bitboard* table, Magic* magics, const uint64_t* knownMagics,
+                           Bitboard (*slowAttacks)(int, Bitboard)) {
+        static Bitboard occupancy[4096];
+        static Bitboard reference[4096];
+        
+        for (int sq = 0; sq < 64; sq++) {
+            Magic& m = magics[sq];
+            //blockers on the board edge never change the attack set
+            Bitboard edges = ((0xFFULL | 0xFF00000000000000ULL) & ~(0xFFULL << (sq & 56))) |
+                             ((0x0101010101010101ULL | 0x8080808080808080ULL) & ~(0x0101010101010101ULL << (sq & 7)));
+            m.mask = slowAttacks(sq, 0) & ~edges;
+            m.shift = 64 - popCount(m.mask);
+            m.magic = knownMagics[sq];
+            m.attacks = (sq == 0) ? table : magics[sq - 1].attacks + size(magics[sq - 1]);
+            
+            //enumerate every subset of the mask (carry-rippler)
+            int count = 0;
+            Bitboard blockers = 0;
+            do {
+                occupancy[count] = blockers;
+                reference[count] = slowAttacks(sq, blockers);
+                count++;
+                blockers = (blockers - m.mask) & m.mask;
+            } while (blockers);
+            
+            if (!fillTable(m, occupancy, reference, count)) {
+                findMagic(m, occupancy, reference, count, sq);
+            }
+        }
+    }
+    
+    //store every reference attack set, failing on a destructive index collision
+    static bool fillTable(Magic& m, const Bitboard* occupancy, const Bitboard* reference, int count) {
+        for (int i = 0; i < size(m); i++) {
+            m.attacks[i] = 0;
+        }
+        for (int i = 0; i < count; i++) {
+            Bitboard& entry = m.attacks[m.index(occupancy[i])];
+            if (entry && entry != reference[i]) {
+                return false;
+            }
+            entry = reference[i];
+        }
+        return true;
+    }
+    
+    //trial-and-error search for a collision-free multiplier
+    static void findMagic(Magic& m, const Bitboard* occupancy, const Bitboard* reference, int count, int sq) {
+        static const uint64_t seeds[8] = { 728, 10316, 55013, 32803, 12281, 15100, 16645, 255 };
+        static int epoch[4096];
+        static int attempt = 0;
+        PRNG rng(seeds[sq >> 3]);
+        for (int i = 0; i < count;) {
+            do {
+                m.magic = rng.sparseRand();
+            } while (popCount((m.magic * m.mask) >> 56) < 6);
+            
+            //epoch stamps avoid clearing the table between failed candidates
+            ++attempt;
+            for (i = 0; i < count; i++) {
+                unsigned idx = m.index(occupancy[i]);
+                if (epoch[idx] < attempt) {
+                    epoch[idx] = attempt;
+                    m.attacks[idx] = reference[i];
+                } else if (m.attacks[idx] != reference[i]) {
+                    break;
+                }
+            }
+        }
+    }
+    
+    static int size(const Magic& m) {
+        return 1 << (64 - m.shift);
+    }
+};
+static const SliderTables sliderTables;
+
+inline Bitboard bishopAttacks(int sq, Bitboard occupied) {
+    const Magic& m = sliderTables.bishopMagics[sq];
+    return m.attacks[m.index(occupied)];
+}
+
+inline Bitboard rookAttacks(int sq, Bitboard occupied) {
+    const Magic& m = sliderTables.rookMagics[sq];
+    return m.attacks[m.index(occupied)];
+}
+
+inline Bitboard queenAttacks(int sq, Bitboard occupied) {
+    return bishopAttacks(sq, occupied) | rookAttacks(sq, occupied);
+}
+
+//leaper attacks and square relations, computed by the compiler so that attack queries are
+//plain table lookups with nothing to initialize or allocate at run time
+struct AttackTables {
+    Bitboard knight[64] = {};
+    Bitboard king[64] = {};
+    Bitboard pawn[3][64] = {}; //indexed by Color, squares a pawn of that color attacks
+    Bitboard between[64][64] = {}; //squares strictly between two aligned squares
+    Bitboard line[64][64] = {};    //the full rank, file or diagonal through two aligned squares
+
+    constexpr AttackTables() {
+        constexpr int knightSteps[8][2] = {
+            {1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}
+        };
+        constexpr int kingSteps[8][2] = {
+            {1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}
+        };
+        for (int sq = 0; sq < 64; sq++) {
+            knight[sq] = stepAttacks(sq, knightSteps);
+            king[sq] = stepAttacks(sq, kingSteps);
+            pawn[static_cast<int>(Color::WHITE)][sq] = stepAttack(sq, -1, 1) | stepAttack(sq, 1, 1);
+            pawn[static_cast<int>(Color::BLACK)][sq] = stepAttack(sq, -1, -1) | stepAttack(sq, 1, -1);
+        }
+        for (int from = 0; from < 64; from++) {
+            Bitboard diagonals = bishopRayAttacks(from, 0);
+            Bitboard lines = rookRayAttacks(from, 0);
+            for (int to = 0; to < 64; to++) {
+                if (from == to) continue;
+                Bitboard pair = squareBB(from) | squareBB(to);
+                if (diagonals & squareBB(to)) {
+                    between[from][to] = bishopRayAttacks(from, squareBB(to)) & bishopRayAttacks(to, squareBB(from));
+                    line[from][to] = (diagonals & bishopRayAttacks(to, 0)) | pair;
+                } else if (lines & squareBB(to)) {
+                    between[from][to] = rookRayAttacks(from, squareBB(to)) & rookRayAttacks(to, squareBB(from));
+                    line[from][to] = (lines & rookRayAttacks(to, 0)) | pair;
+                }
+            }
+        }
+    }
+
+    static constexpr Bitboard stepAttack(int sq, int fileStep, int rankStep) {
+        int file = (sq & 7) + fileStep;
+        int rank = (sq >> 3) + rankStep;
+        if (file < 0 || file >= 8 || rank < 0 || rank >= 8) return 0;
+        return squareBB(rank * 8 + file);
+    }
+
+    static constexpr Bitboard stepAttacks(int sq, const int (&steps)[8][2]) {
+        Bitboard attacks = 0;
+        for (const auto& step : steps) {
+            attacks |= stepAttack(sq, step[0], step[1]);
+        }
+        return attacks;
+    }
+};
+static constexpr AttackTables attackTables{};
+
+//material values in centipawns, indexed by PieceType
+static const int pieceValues[7] = { 0, 100, 320, 330, 500, 900, 0 };
+
+//middlegame and endgame piece-square bonuses, written from white's side with rank 8 on top
+static const int pawnTable[2][64] = {
+    {   0,   0,   0,   0,   0,   0,   0,   0,
+       50,  50,  50,  50,  50,  50,  50,  50,
+       10,  10,  20,  30,  30,  20,  10,  10,
+        5,   5,  10,  25,  25,  10,   5,   5,
+        0,   0,   0,  20,  20,   0,   0,   0,
+        5,  -5, -10,   0,   0, -10,  -5,   5,
+        5,  10,  10, -20, -20,  10,  10,   5,
+        0,   0,   0,   0,   0,   0,   0,   0 },
+    {   0,   0,   0,   0,   0,   0,   0,   0,
+       80,  80,  80,  80,  80,  80,  80,  80,
+       50,  50,  50,  50,  50,  50,  50,  50,
+       30,  30,  30,  30,  30,  30,  30,  30,
+       15,  15,  15,  15,  15,  15,  15,  15,
+        5,   5,   5,   5,   5,   5,   5,   5,
+        0,   0,   0,   0,   0,   0,   0,   0,
+        0,   0,   0,   0,   0,   0,   0,   0 }
+};
+static const int knightTable[64] = {
+    -50, -40, -30, -30, -30, -30, -40, -50,
+    -40, -20,   0,   0,   0,   0, -20, -40,
+    -30,   0,  10,  15,  15,  10,   0, -30,
+    -30,   5,  15,  20,  20,  15,   5, -30,
+    -30,   0,  15,  20,  20,  15,   0, -30,
+    -30,   5,  10,  15,  15,  10,   5, -30,
+    -40, -20,   0,   5,   5,   0, -20, -40,
+    -50, -40, -30, -30, -30, -30, -40, -50
+};
+static const int bishopTable[64] = {
+    -20, -10, -10, -10, -10, -10, -10, -20,
+    -10,   0,   0,   0,   0,   0,   0, -10,
+    -10,   0,   5,  10,  10,   5,   0, -10,
+    -10,   5,   5,  10,  10,   5,   5, -10,
+    -10,   0,  10,  10,  10,  10,   0, -10,
+    -10,  10,  10,  10,  10,  10,  10, -10,
+    -10,   5,   0,   0,   0,   0,   5, -10,
+    -20, -10, -10, -10, -10, -10, -10, -20
+};
+static const int rookTable[64] = {
+      0,   0,   0,   0,   0,   0,   0,   0,
+      5,  10,  10,  10,  10,  10,  10,   5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+      0,   0,   0,   5,   5,   0,   0,   0
+};
+static const int queenTable[64] = {
+    -20, -10, -10,  -5,  -5, -10, -10, -20,
+    -10,   0,   0,   0,   0,   0,   0, -10,
+    -10,   0,   5,   5,   5,   5,   0, -10,
+     -5,   0,   5,   5,   5,   5,   0,  -5,
+      0,   0,   5,   5,   5,   5,   0,  -5,
+    -10,   5,   5,   5,   5,   5,   0, -10,
+    -10,   0,   5,   0,   0,   0,   0, -10,
+    -20, -10, -10,  -5,  -5, -10, -10, -20
+};
+static const int kingTable[2][64] = {
+    { -30, -40, -40, -50, -50, -40, -40, -30,
+      -30, -40, -40, -50, -50, -40, -40, -30,
+      -30, -40, -40, -50, -50, -40, -40, -30,
+      -30, -40, -40, -50, -50, -40, -40, -30,
+      -20, -30, -30, -40, -40, -30, -30, -20,
+      -10, -20, -20, -20, -20, -20, -20, -10,
+       20,  20,   0,   0,   0,   0,  20,  20,
+       20,  30,  10,   0,   0,  10,  30,  20 },
+    { -50, -40, -30, -20, -20, -30, -40, -50,
+      -30, -20, -10,   0,   0, -10, -20, -30,
+      -30, -10,  20,  30,  30,  20, -10, -30,
+      -30, -10,  30,  40,  40,  30, -10, -30,
+      -30, -10,  30,  40,  40,  30, -10, -30,
+      -30, -10,  20,  30,  30,  20, -10, -30,
+      -30, -30,   0,   0,   0,   0, -30, -30,
+      -50, -30, -30, -30, -30, -30, -30, -50 }
+};
+
+//game phase weight of each piece type; 24 is the full set of minor and major pieces
+static const int phaseWeights[7] = { 0, 0, 1, 1, 2, 4, 0 };
+static const int MAX_PHASE = 24;
+
+//material plus piece-square score of every piece on every square, signed for white, for the
+//middlegame [0] and endgame [1]; the board adds and removes entries as pieces come and go
+struct EvalTables {
+    int score[2][3][7][64]; //indexed by phase, Color, PieceType, square
+    
+    EvalTables() {
+        for (int phase = 0; phase < 2; phase++) {
+            for (int color = 0; color < 3; color++) {
+                for (int type = 0; type < 7; type++) {
+                    for (int sq = 0; sq < 64; sq++) {
+                        score[phase][color][type][sq] = 0;
+                    }
+                }
+            }
+            for (int sq = 0; sq < 64; sq++) {
+                //the tables have a8 first, a white piece on LERF square sq sits at sq ^ 56
+                int bonus[7] = { 0, pawnTable[phase][sq ^ 56], knightTable[sq ^ 56], bishopTable[sq ^ 56],
+                                 rookTable[sq ^ 56], queenTable[sq ^ 56], kingTable[phase][sq ^ 56] };
+                for (int type = 1; type < 7; type++) {
+                    int value = pieceValues[type] + bonus[type];
+                    score[phase][static_cast<int>(Color::WHITE)][type][sq] = value;
+                    score[phase][static_cast<int>(Color::BLACK)][type][sq ^ 56] = -value;
+                }
+            }
+        }
+    }
+};
+static const EvalTables evalTables;
+
+//which part of the legal moves to generate: captures include en passant and every promotion,
+//quiets are the remaining moves including castling
+enum class GenType : uint8_t {
+    ALL, CAPTURES, QUIETS
+};
+
+enum class DrawReason : uint8_t {
+    NONE, STALEMATE, FIFTY_MOVE, INSUFFICIENT_MATERIAL, REPETITION
+};
+
+//final or current outcome of a game, as stored in game records
+enum class GameResult : uint8_t {
+    UNKNOWN, WHITE_WINS, BLACK_WINS, DRAW
+};
+
+//outcome-related facts about one position, cached on the board until it changes
+struct GameStatus {
+    int legalMoveCount;
+    bool inCheck;
+    DrawReason drawReason;
+    
+    GameStatus() : legalMoveCount(0), inCheck(false), drawReason(DrawReason::NONE) {}
+    
+    bool isCheckmate() const {
+        return inCheck && legalMoveCount == 0;
+    }
+    
+    bool isDraw() const {
+        return drawReason != DrawReason::NONE;
+    }
+    
+    bool isGameOver() const {
+        return legalMoveCount == 0 || isDraw();
+    }
+};
+
+//random keys for Zobrist hashing, from a fixed seed so hashes are stable across runs
+struct ZobristKeys {
+    uint64_t pieces[3][7][64]; //indexed by Color, PieceType, square
+    uint64_t blackToMove;
+    uint64_t castling[4];      //white king-side, white queen-side, black king-side, black queen-side
+    uint64_t enPassantFile[8];
+    
+    ZobristKeys() {
+        PRNG rng(1070372);
+        for (int color = 0; color < 3; color++) {
+            for (int type = 0; type < 7; type++) {
+                for (int sq = 0; sq < 64; sq++) {
+                    pieces[color][type][sq] = rng.rand64();
+                }
+            }
+        }
+        blackToMove = rng.rand64();
+        for (auto& key : castling) {
+            key = rng.rand64();
+        }
+        for (auto& key : enPassantFile) {
+            key = rng.rand64();
+        }
+    }
+};
+static const ZobristKeys zobristKeys;
+
+//the 781 random numbers of the Polyglot book key, copied from the Polyglot book format: 768 for
+//the pieces (64 squares for each of black pawn, white pawn, black knight ... white king), 4 for
+//castling rights, 8 for en passant files and 1 for white to move
+struct PolyglotRandom {
+    static const int CASTLING = 768;
+    static const int EN_PASSANT = 772;
+    static const int TURN = 780;
+    
+    uint64_t keys[781] = {
+        0x9D39247E33776D41, 0x2AF7398005AAA5C7, 0x44DB015024623547, 0x9C15F73E62A76AE2,
+        0x75834465489C0C89, 0x3290AC3A203001BF, 0x0FBBAD1F61042279, 0xE83A908FF2FB60CA,
+        0x0D7E765D58755C10, 0x1A083822CEAFE02D, 0x9605D5F0E25EC3B0, 0xD021FF5CD13A2ED5,
+        0x40BDF15D4A672E32, 0x011355146FD56395, 0x5DB4832046F3D9E5, 0x239F8B2D7FF719CC,
+        0x05D1A1AE85B49AA1, 0x679F848F6E8FC971, 0x7449BBFF801FED0B, 0x7D11CDB1C3B7ADF0,
+        0x82C7709E781EB7CC, 0xF3218F1C9510786C, 0x331478F3AF51BBE6, 0x4BB38DE5E7219443,
+        0xAA649C6EBCFD50FC, 0x8DBD98A352AFD40B, 0x87D2074B81D79217, 0x19F3C751D3E92AE1,
+        0xB4AB30F062B19ABF, 0x7B0500AC42047AC4, 0xC9452CA81A09D85D, 0x24AA6C514DA27500,
+        0x4C9F34427501B447, 0x14A68FD73C910841, 0xA71B9B83461CBD93, 0x03488B95B0F1850F,
+        0x637B2B34FF93C040, 0x09D1BC9A3DD90A94, 0x3575668334A1DD3B, 0x735E2B97A4C45A23,
+        0x18727070F1BD400B, 0x1FCBACD259BF02E7, 0xD310A7C2CE9B6555, 0xBF983FE0FE5D8244,
+        0x9F74D14F7454A824, 0x51EBDC4AB9BA3035, 0x5C82C505DB9AB0FA, 0xFCF7FE8A3430B241,
+        0x3253A729B9BA3DDE, 0x8C74C368081B3075, 0xB9BC6C87167C33E7, 0x7EF48F2B83024E20,
+        0x11D505D4C351BD7F, 0x6568FCA92C76A243, 0x4DE0B0F40F32A7B8, 0x96D693460CC37E5D,
+        0x42E240CB63689F2F, 0x6D2BDCDAE2919661, 0x42880B0236E4D951, 0x5F0F4A5898171BB6,
+        0x39F890F579F92F88, 0x93C5B5F47356388B, 0x63DC359D8D231B78, 0xEC16CA8AEA98AD76,
+        0x5355F900C2A82DC7, 0x07FB9F855A997142, 0x5093417AA8A7ED5E, 0x7BCBC38DA25A7F3C,
+        0x19FC8A768CF4B6D4, 0x637A7780DECFC0D9, 0x8249A47AEE0E41F7, 0x79AD695501E7D1E8,
+        0x14ACBAF4777D5776, 0xF145B6BECCDEA195, 0xDABF2AC8201752FC, 0x24C3C94DF9C8D3F6,
+        0xBB6E2924F03912EA, 0x0CE26C0B95C980D9, 0xA49CD132BFBF7CC4, 0xE99D662AF4243939,
+        0x27E6AD7891165C3F, 0x8535F040B9744FF1, 0x54B3F4FA5F40D873, 0x72B12C32127FED2B,
+        0xEE954D3C7B411F47, 0x9A85AC909A24EAA1, 0x70AC4CD9F04F21F5, 0xF9B89D3E99A075C2,
+        0x87B3E2B2B5C907B1, 0xA366E5B8C54F48B8, 0xAE4A9346CC3F7CF2, 0x1920C04D47267BBD,
+        0x87BF02C6B49E2AE9, 0x092237AC237F3859, 0xFF07F64EF8ED14D0, 0x8DE8DCA9F03CC54E,
+        0x9C1633264DB49C89, 0xB3F22C3D0B0B38ED, 0x390E5FB44D01144B, 0x5BFEA5B4712768E9,
+        0x1E1032911FA78984, 0x9A74ACB964E78CB3, 0x4F80F7A035DAFB04, 0x6304D09A0B3738C4,
+        0x2171E64683023A08, 0x5B9B63EB9CEFF80C, 0x506AACF489889342, 0x1881AFC9A3A701D6,
+        0x6503080440750644, 0xDFD395339CDBF4A7, 0xEF927DBCF00C20F2, 0x7B32F7D1E03680EC,
+        0xB9FD7620E7316243, 0x05A7E8A57DB91B77, 0xB5889C6E15630A75, 0x4A750A09CE9573F7,
+        0xCF464CEC899A2F8A, 0xF538639CE705B824, 0x3C79A0FF5580EF7F, 0xEDE6C87F8477609D,
+        0x799E81F05BC93F31, 0x86536B8CF3428A8C, 0x97D7374C60087B73, 0xA246637CFF328532,
+        0x043FCAE60CC0EBA0, 0x920E449535DD359E, 0x70EB093B15B290CC, 0x73A1921916591CBD,
+        0x56436C9FE1A1AA8D, 0xEFAC4B70633B8F81, 0xBB215798D45DF7AF, 0x45F20042F24F1768,
+        0x930F80F4E8EB7462, 0xFF6712FFCFD75EA1, 0xAE623FD67468AA70, 0xDD2C5BC84BC8D8FC,
+        0x7EED120D54CF2DD9, 0x22FE545401165F1C, 0xC91800E98FB99929, 0x808BD68E6AC10365,
+        0xDEC468145B7605F6, 0x1BEDE3A3AEF53302, 0x43539603D6C55602, 0xAA969B5C691CCB7A,
+        0xA87832D392EFEE56, 0x65942C7B3C7E11AE, 0xDED2D633CAD004F6, 0x21F08570F420E565,
+        0xB415938D7DA94E3C, 0x91B859E59ECB6350, 0x10CFF333E0ED804A, 0x28AED140BE0BB7DD,
+        0xC5CC1D89724FA456, 0x5648F680F11A2741, 0x2D255069F0B7DAB3, 0x9BC5A38EF729ABD4,
+        0xEF2F054308F6A2BC, 0xAF2042F5CC5C2858, 0x480412BAB7F5BE2A, 0xAEF3AF4A563DFE43,
+        0x19AFE59AE451497F, 0x52593803DFF1E840, 0xF4F076E65F2CE6F0, 0x11379625747D5AF3,
+        0xBCE5D2248682C115, 0x9DA4243DE836994F, 0x066F70B33FE09017, 0x4DC4DE189B671A1C,
+        0x51039AB7712457C3, 0xC07A3F80C31FB4B4, 0xB46EE9C5E64A6E7C, 0xB3819A42ABE61C87,
+        0x21A007933A522A20, 0x2DF16F761598AA4F, 0x763C4A1371B368FD, 0xF793C46702E086A0,
+        0xD7288E012AEB8D31, 0xDE336A2A4BC1C44B, 0x0BF692B38D079F23, 0x2C604A7A177326B3,
+        0x4850E73E03EB6064, 0xCFC447F1E53C8E1B, 0xB05CA3F564268D99, 0x9AE182C8BC9474E8,
+        0xA4FC4BD4FC5558CA, 0xE755178D58FC4E76, 0x69B97DB1A4C03DFE, 0xF9B5B7C4ACC67C96,
+        0xFC6A82D64B8655FB, 0x9C684CB6C4D24417, 0x8EC97D2917456ED0, 0x6703DF9D2924E97E,
+        0xC547F57E42A7444E, 0x78E37644E7CAD29E, 0xFE9A44E9362F05FA, 0x08BD35CC38336615,
+        0x9315E5EB3A129ACE, 0x94061B871E04DF75, 0xDF1D9F9D784BA010, 0x3BBA57B68871B59D,
+        0xD2B7ADEEDED1F73F, 0xF7A255D83BC373F8, 0xD7F4F2448C0CEB81, 0xD95BE88CD210FFA7,
+        0x336F52F8FF4728E7, 0xA74049DAC312AC71, 0xA2F61BB6E437FDB5, 0x4F2A5CB07F6A35B3,
+        0x87D380BDA5BF7859, 0x16B9F7E06C453A21, 0x7BA2484C8A0FD54E, 0xF3A678CAD9A2E38C,
+        0x39B0BF7DDE437BA2, 0xFCAF55C1BF8A4424, 0x18FCF680573FA594, 0x4C0563B89F495AC3,
+        0x40E087931A00930D, 0x8CFFA9412EB642C1, 0x68CA39053261169F, 0x7A1EE967D27579E2,
+        0x9D1D60E5076F5B6F, 0x3810E399B6F65BA2, 0x32095B6D4AB5F9B1, 0x35CAB62109DD038A,
+        0xA90B24499FCFAFB1, 0x77A225A07CC2C6BD, 0x513E5E634C70E331, 0x4361C0CA3F692F12,
+        0xD941ACA44B20A45B, 0x528F7C8602C5807B, 0x52AB92BEB9613989, 0x9D1DFA2EFC557F73,
+        0x722FF175F572C348, 0x1D1260A51107FE97, 0x7A249A57EC0C9BA2, 0x04208FE9E8F7F2D6,
+        0x5A110C6058B920A0, 0x0CD9A497658A5698, 0x56FD23C8F9715A4C, 0x284C847B9D887AAE,
+        0x04FEABFBBDB619CB, 0x742E1E651C60BA83, 0x9A9632E65904AD3C, 0x881B82A13B51B9E2,
+        0x506E6744CD974924, 0xB0183DB56FFC6A79, 0x0ED9B915C66ED37E, 0x5E11E86D5873D484,
+        0xF678647E3519AC6E, 0x1B85D488D0F20CC5, 0xDAB9FE6525D89021, 0x0D151D86ADB73615,
+        0xA865A54EDCC0F019, 0x93C42566AEF98FFB, 0x99E7AFEABE000731, 0x48CBFF086DDF285A,
+        0x7F9B6AF1EBF78BAF, 0x58627E1A149BBA21, 0x2CD16E2ABD791E33, 0xD363EFF5F0977996,
+        0x0CE2A38C344A6EED, 0x1A804AADB9CFA741, 0x907F30421D78C5DE, 0x501F65EDB3034D07,
+        0x37624AE5A48FA6E9, 0x957BAF61700CFF4E, 0x3A6C27934E31188A, 0xD49503536ABCA345,
+        0x088E049589C432E0, 0xF943AEE7FEBF21B8, 0x6C3B8E3E336139D3, 0x364F6FFA464EE52E,
+        0xD60F6DCEDC314222, 0x56963B0DCA418FC0, 0x16F50EDF91E513AF, 0xEF1955914B609F93,
+        0x565601C0364E3228, 0xECB53939887E8175, 0xBAC7A9A18531294B, 0xB344C470397BBA52,
+        0x65D34954DAF3CEBD, 0xB4B81B3FA97511E2, 0xB422061193D6F6A7, 0x071582401C38434D,
+        0x7A13F18BBEDC4FF5, 0xBC4097B116C524D2, 0x59B97885E2F2EA28, 0x99170A5DC3115544,
+        0x6F423357E7C6A9F9, 0x325928EE6E6F8794, 0xD0E4366228B03343, 0x565C31F7DE89EA27,
+        0x30F5611484119414, 0xD873DB391292ED4F, 0x7BD94E1D8E17DEBC, 0xC7D9F16864A76E94,
+        0x947AE053EE56E63C, 0xC8C93882F9475F5F, 0x3A9BF55BA91F81CA, 0xD9A11FBB3D9808E4,
+        0x0FD22063EDC29FCA, 0xB3F256D8ACA0B0B9, 0xB03031A8B4516E84, 0x35DD37D5871448AF,
+        0xE9F6082B05542E4E, 0xEBFAFA33D7254B59, 0x9255ABB50D532280, 0xB9AB4CE57F2D34F3,
+        0x693501D628297551, 0xC62C58F97DD949BF, 0xCD454F8F19C5126A, 0xBBE83F4ECC2BDECB,
+        0xDC842B7E2819E230, 0xBA89142E007503B8, 0xA3BC941D0A5061CB, 0xE9F6760E32CD8021,
+        0x09C7E552BC76492F, 0x852F54934DA55CC9, 0x8107FCCF064FCF56, 0x098954D51FFF6580,
+        0x23B70EDB1955C4BF, 0xC330DE426430F69D, 0x4715ED43E8A45C0A, 0xA8D7E4DAB780A08D,
+        0x0572B974F03CE0BB, 0xB57D2E985E1419C7, 0xE8D9ECBE2CF3D73F, 0x2FE4B17170E59750,
+        0x11317BA87905E790, 0x7FBF21EC8A1F45EC, 0x1725CABFCB045B00, 0x964E915CD5E2B207,
+        0x3E2B8BCBF016D66D, 0xBE7444E39328A0AC, 0xF85B2B4FBCDE44B7, 0x49353FEA39BA63B1,
+        0x1DD01AAFCD53486A, 0x1FCA8A92FD719F85, 0xFC7C95D827357AFA, 0x18A6A990C8B35EBD,
+        0xCCCB7005C6B9C28D, 0x3BDBB92C43B17F26, 0xAA70B5B4F89695A2, 0xE94C39A54A98307F,
+        0xB7A0B174CFF6F36E, 0xD4DBA84729AF48AD, 0x2E18BC1AD9704A68, 0x2DE0966DAF2F8B1C,
+        0xB9C11D5B1E43A07E, 0x64972D68DEE33360, 0x94628D38D0C20584, 0xDBC0D2B6AB90A559,
+        0xD2733C4335C6A72F, 0x7E75D99D94A70F4D, 0x6CED1983376FA72B, 0x97FCAACBF030BC24,
+        0x7B77497B32503B12, 0x8547EDDFB81CCB94, 0x79999CDFF70902CB, 0xCFFE1939438E9B24,
+        0x829626E3892D95D7, 0x92FAE24291F2B3F1, 0x63E22C147B9C3403, 0xC678B6D860284A1C,
+        0x5873888850659AE7, 0x0981DCD296A8736D, 0x9F65789A6509A440, 0x9FF38FED72E9052F,
+        0xE479EE5B9930578C, 0xE7F28ECD2D49EECD, 0x56C074A581EA17FE, 0x5544F7D774B14AEF,
+        0x7B3F0195FC6F290F, 0x12153635B2C0CF57, 0x7F5126DBBA5E0CA7, 0x7A76956C3EAFB413,
+        0x3D5774A11D31AB39, 0x8A1B083821F40CB4, 0x7B4A38E32537DF62, 0x950113646D1D6E03,
+        0x4DA8979A0041E8A9, 0x3BC36E078F7515D7, 0x5D0A12F27AD310D1, 0x7F9D1A2E1EBE1327,
+        0xDA3A361B1C5157B1, 0xDCDD7D20903D0C25, 0x36833336D068F707, 0xCE68341F79893389,
+        0xAB9090168DD05F34, 0x43954B3252DC25E5, 0xB438C2B67F98E5E9, 0x10DCD78E3851A492,
+        0xDBC27AB5447822BF, 0x9B3CDB65F82CA382, 0xB67B7896167B4C84, 0xBFCED1B0048EAC50,
+        0xA9119B60369FFEBD, 0x1FFF7AC80904BF45, 0xAC12FB171817EEE7, 0xAF08DA9177DDA93D,
+        0x1B0CAB936E65C744, 0xB559EB1D04E5E932, 0xC37B45B3F8D6F2BA, 0xC3A9DC228CAAC9E9,
+        0xF3B8B6675A6507FF, 0x9FC477DE4ED681DA, 0x67378D8ECCEF96CB, 0x6DD856D94D259236,
+        0xA319CE15B0B4DB31, 0x073973751F12DD5E, 0x8A8E849EB32781A5, 0xE1925C71285279F5,
+        0x74C04BF1790C0EFE, 0x4DDA48153C94938A, 0x9D266D6A1CC0542C, 0x7440FB816508C4FE,
+        0x13328503DF48229F, 0xD6BF7BAEE43CAC40, 0x4838D65F6EF6748F, 0x1E152328F3318DEA,
+        0x8F8419A348F296BF, 0x72C8834A5957B511, 0xD7A023A73260B45C, 0x94EBC8ABCFB56DAE,
+        0x9FC10D0F989993E0, 0xDE68A2355B93CAE6, 0xA44CFE79AE538BBE, 0x9D1D84FCCE371425,
+        0x51D2B1AB2DDFB636, 0x2FD7E4B9E72CD38C, 0x65CA5B96B7552210, 0xDD69A0D8AB3B546D,
+        0x604D51B25FBF70E2, 0x73AA8A564FB7AC9E, 0x1A8C1E992B941148, 0xAAC40A2703D9BEA0,
+        0x764DBEAE7FA4F3A6, 0x1E99B96E70A9BE8B, 0x2C5E9DEB57EF4743, 0x3A938FEE32D29981,
+        0x26E6DB8FFDF5ADFE, 0x469356C504EC9F9D, 0xC8763C5B08D1908C, 0x3F6C6AF859D80055,
+        0x7F7CC39420A3A545, 0x9BFB227EBDF4C5CE, 0x89039D79D6FC5C5C, 0x8FE88B57305E2AB6,
+        0xA09E8C8C35AB96DE, 0xFA7E393983325753, 0xD6B6D0ECC617C699, 0xDFEA21EA9E7557E3,
+        0xB67C1FA481680AF8, 0xCA1E3785A9E724E5, 0x1CFC8BED0D681639, 0xD18D8549D140CAEA,
+        0x4ED0FE7E9DC91335, 0xE4DBF0634473F5D2, 0x1761F93A44D5AEFE, 0x53898E4C3910DA55,
+        0x734DE8181F6EC39A, 0x2680B122BAA28D97, 0x298AF231C85BAFAB, 0x7983EED3740847D5,
+        0x66C1A2A1A60CD889, 0x9E17E49642A3E4C1, 0xEDB454E7BADC0805, 0x50B704CAB602C329,
+        0x4CC317FB9CDDD023, 0x66B4835D9EAFEA22, 0x219B97E26FFC81BD, 0x261E4E4C0A333A9D,
+        0x1FE2CCA76517DB90, 0xD7504DFA8816EDBB, 0xB9571FA04DC089C8, 0x1DDC0325259B27DE,
+        0xCF3F4688801EB9AA, 0xF4F5D05C10CAB243, 0x38B6525C21A42B0E, 0x36F60E2BA4FA6800,
+        0xEB3593803173E0CE, 0x9C4CD6257C5A3603, 0xAF0C317D32ADAA8A, 0x258E5A80C7204C4B,
+        0x8B889D624D44885D, 0xF4D14597E660F855, 0xD4347F66EC8941C3, 0xE699ED85B0DFB40D,
+        0x2472F6207C2D0484, 0xC2A1E7B5B459AEB5, 0xAB4F6451CC1D45EC, 0x63767572AE3D6174,
+        0xA59E0BD101731A28, 0x116D0016CB948F09, 0x2CF9C8CA052F6E9F, 0x0B090A7560A968E3,
+        0xABEEDDB2DDE06FF1, 0x58EFC10B06A2068D, 0xC6E57A78FBD986E0, 0x2EAB8CA63CE802D7,
+        0x14A195640116F336, 0x7C0828DD624EC390, 0xD74BBE77E6116AC7, 0x804456AF10F5FB53,
+        0xEBE9EA2ADF4321C7, 0x03219A39EE587A30, 0x49787FEF17AF9924, 0xA1E9300CD8520548,
+        0x5B45E522E4B1B4EF, 0xB49C3B3995091A36, 0xD4490AD526F14431, 0x12A8F216AF9418C2,
+        0x001F837CC7350524, 0x1877B51E57A764D5, 0xA2853B80F17F58EE, 0x993E1DE72D36D310,
+        0xB3598080CE64A656, 0x252F59CF0D9F04BB, 0xD23C8E176D113600, 0x1BDA0492E7E4586E,
+        0x21E0BD5026C619BF, 0x3B097ADAF088F94E, 0x8D14DEDB30BE846E, 0xF95CFFA23AF5F6F4,
+        0x3871700761B3F743, 0xCA672B91E9E4FA16, 0x64C8E531BFF53B55, 0x241260ED4AD1E87D,
+        0x106C09B972D2E822, 0x7FBA195410E5CA30, 0x7884D9BC6CB569D8, 0x0647DFEDCD894A29,
+        0x63573FF03E224774, 0x4FC8E9560F91B123, 0x1DB956E450275779, 0xB8D91274B9E9D4FB,
+        0xA2EBEE47E2FBFCE1, 0xD9F1F30CCD97FB09, 0xEFED53D75FD64E6B, 0x2E6D02C36017F67F,
+        0xA9AA4D20DB084E9B, 0xB64BE8D8B25396C1, 0x70CB6AF7C2D5BCF0, 0x98F076A4F7A2322E,
+        0xBF84470805E69B5F, 0x94C3251F06F90CF3, 0x3E003E616A6591E9, 0xB925A6CD0421AFF3,
+        0x61BDD1307C66E300, 0xBF8D5108E27E0D48, 0x240AB57A8B888B20, 0xFC87614BAF287E07,
+        0xEF02CDD06FFDB432, 0xA1082C0466DF6C0A, 0x8215E577001332C8, 0xD39BB9C3A48DB6CF,
+        0x2738259634305C14, 0x61CF4F94C97DF93D, 0x1B6BACA2AE4E125B, 0x758F450C88572E0B,
+        0x959F587D507A8359, 0xB063E962E045F54D, 0x60E8ED72C0DFF5D1, 0x7B64978555326F9F,
+        0xFD080D236DA814BA, 0x8C90FD9B083F4558, 0x106F72FE81E2C590, 0x7976033A39F7D952,
+        0xA4EC0132764CA04B, 0x733EA705FAE4FA77, 0xB4D8F77BC3E56167, 0x9E21F4F903B33FD9,
+        0x9D765E419FB69F6D, 0xD30C088BA61EA5EF, 0x5D94337FBFAF7F5B, 0x1A4E4822EB4D7A59,
+        0x6FFE73E81B637FB3, 0xDDF957BC36D8B9CA, 0x64D0E29EEA8838B3, 0x08DD9BDFD96B9F63,
+        0x087E79E5A57D1D13, 0xE328E230E3E2B3FB, 0x1C2559E30F0946BE, 0x720BF5F26F4D2EAA,
+        0xB0774D261CC609DB, 0x443F64EC5A371195, 0x4112CF68649A260E, 0xD813F2FAB7F5C5CA,
+        0x660D3257380841EE, 0x59AC2C7873F910A3, 0xE846963877671A17, 0x93B633ABFA3469F8,
+        0xC0C0F5A60EF4CDCF, 0xCAF21ECD4377B28C, 0x57277707199B8175, 0x506C11B9D90E8B1D,
+        0xD83CC2687A19255F, 0x4A29C6465A314CD1, 0xED2DF21216235097, 0xB5635C95FF7296E2,
+        0x22AF003AB672E811, 0x52E762596BF68235, 0x9AEBA33AC6ECC6B0, 0x944F6DE09134DFB6,
+        0x6C47BEC883A7DE39, 0x6AD047C430A12104, 0xA5B1CFDBA0AB4067, 0x7C45D833AFF07862,
+        0x5092EF950A16DA0B, 0x9338E69C052B8E7B, 0x455A4B4CFE30E3F5, 0x6B02E63195AD0CF8,
+        0x6B17B224BAD6BF27, 0xD1E0CCD25BB9C169, 0xDE0C89A556B9AE70, 0x50065E535A213CF6,
+        0x9C1169FA2777B874, 0x78EDEFD694AF1EED, 0x6DC93D9526A50E68, 0xEE97F453F06791ED,
+        0x32AB0EDB696703D3, 0x3A6853C7E70757A7, 0x31865CED6120F37D, 0x67FEF95D92607890,
+        0x1F2B1D1F15F6DC9C, 0xB69E38A8965C6B65, 0xAA9119FF184CCCF4, 0xF43C732873F24C13,
+        0xFB4A3D794A9A80D2, 0x3550C2321FD6109C, 0x371F77E76BB8417E, 0x6BFA9AAE5EC05779,
+        0xCD04F3FF001A4778, 0xE3273522064480CA, 0x9F91508BFFCFC14A, 0x049A7F41061A9E60,
+        0xFCB6BE43A9F2FE9B, 0x08DE8A1C7797DA9B, 0x8F9887E6078735A1, 0xB5B4071DBFC73A66,
+        0x230E343DFBA08D33, 0x43ED7F5A0FAE657D, 0x3A88A0FBBCB05C63, 0x21874B8B4D2DBC4F,
+        0x1BDEA12E35F6A8C9, 0x53C065C6C8E63528, 0xE34A1D250E7A8D6B, 0xD6B04D3B7651DD7E,
+        0x5E90277E7CB39E2D, 0x2C046F22062DC67D, 0xB10BB459132D0A26, 0x3FA9DDFB67E2F199,
+        0x0E09B88E1914F7AF, 0x10E8B35AF3EEAB37, 0x9EEDECA8E272B933, 0xD4C718BC4AE8AE5F,
+        0x81536D601170FC20, 0x91B534F885818A06, 0xEC8177F83F900978, 0x190E714FADA5156E,
+        0xB592BF39B0364963, 0x89C350C893AE7DC1, 0xAC042E70F8B383F2, 0xB49B52E587A1EE60,
+        0xFB152FE3FF26DA89, 0x3E666E6F69AE2C15, 0x3B544EBE544C19F9, 0xE805A1E290CF2456,
+        0x24B33C9D7ED25117, 0xE74733427B72F0C1, 0x0A804D18B7097475, 0x57E3306D881EDB4F,
+        0x4AE7D6A36EB5DBCB, 0x2D8D5432157064C8, 0xD1E649DE1E7F268B, 0x8A328A1CEDFE552C,
+        0x07A3AEC79624C7DA, 0x84547DDC3E203C94, 0x990A98FD5071D263, 0x1A4FF12616EEFC89,
+        0xF6F7FD1431714200, 0x30C05B1BA332F41C, 0x8D2636B81555A786, 0x46C9FEB55D120902,
+        0xCCEC0A73B49C9921, 0x4E9D2827355FC492, 0x19EBB029435DCB0F, 0x4659D2B743848A2C,
+        0x963EF2C96B33BE31, 0x74F85198B05A2E7D, 0x5A0F544DD2B1FB18, 0x03727073C2E134B1,
+        0xC7F6AA2DE59AEA61, 0x352787BAA0D7C22F, 0x9853EAB63B5E0B35, 0xABBDCDD7ED5C0860,
+        0xCF05DAF5AC8D77B0, 0x49CAD48CEBF4A71E, 0x7A4C10EC2158C4A6, 0xD9E92AA246BF719E,
+        0x13AE978D09FE5557, 0x730499AF921549FF, 0x4E4B705B92903BA4, 0xFF577222C14F0A3A,
+        0x55B6344CF97AAFAE, 0xB862225B055B6960, 0xCAC09AFBDDD2CDB4, 0xDAF8E9829FE96B5F,
+        0xB5FDFC5D3132C498, 0x310CB380DB6F7503, 0xE87FBB46217A360E, 0x2102AE466EBB1148,
+        0xF8549E1A3AA5E00D, 0x07A69AFDCC42261A, 0xC4C118BFE78FEAAE, 0xF9F4892ED96BD438,
+        0x1AF3DBE25D8F45DA, 0xF5B4B0B0D2DEEEB4, 0x962ACEEFA82E1C84, 0x046E3ECAAF453CE9,
+        0xF05D129681949A4C, 0x964781CE734B3C84, 0x9C2ED44081CE5FBD, 0x522E23F3925E319E,
+        0x177E00F9FC32F791, 0x2BC60A63A6F3B3F2, 0x222BBFAE61725606, 0x486289DDCC3D6780,
+        0x7DC7785B8EFDFC80, 0x8AF38731C02BA980, 0x1FAB64EA29A2DDF7, 0xE4D9429322CD065A,
+        0x9DA058C67844F20C, 0x24C0E332B70019B0, 0x233003B5A6CFE6AD, 0xD586BD01C5C217F6,
+        0x5E5637885F29BC2B, 0x7EBA726D8C94094B, 0x0A56A5F0BFE39272, 0xD79476A84EE20D06,
+        0x9E4C1269BAA4BF37, 0x17EFEE45B0DEE640, 0x1D95B0A5FCF90BC6, 0x93CBE0B699C2585D,
+        0x65FA4F227A2B6D79, 0xD5F9E858292504D5, 0xC2B5A03F71471A6F, 0x59300222B4561E00,
+        0xCE2F8642CA0712DC, 0x7CA9723FBB2E8988, 0x2785338347F2BA08, 0xC61BB3A141E50E8C,
+        0x150F361DAB9DEC26, 0x9F6A419D382595F4, 0x64A53DC924FE7AC9, 0x142DE49FFF7A7C3D,
+        0x0C335248857FA9E7, 0x0A9C32D5EAE45305, 0xE6C42178C4BBB92E, 0x71F1CE2490D20B07,
+        0xF1BCC3D275AFE51A, 0xE728E8C83C334074, 0x96FBF83A12884624, 0x81A1549FD6573DA5,
+        0x5FA7867CAF35E149, 0x56986E2EF3ED091B, 0x917F1DD5F8886C61, 0xD20D8C88C8FFE65F,
+        0x31D71DCE64B2C310, 0xF165B587DF898190, 0xA57E6339DD2CF3A0, 0x1EF6E6DBB1961EC9,
+        0x70CC73D90BC26E24, 0xE21A6B35DF0C3AD7, 0x003A93D8B2806962, 0x1C99DED33CB890A1,
+        0xCF3145DE0ADD4289, 0xD0E4427A5514FB72, 0x77C621CC9FB3A483, 0x67A34DAC4356550B,
+        0xF8D626AAAF278509
+    };
+};
+static const PolyglotRandom polyglotRandom;
+
+//what doMove overwrites and undoMove needs back: everything that cannot be worked out from the move
+struct StateInfo {
+    Move move;
+    PieceType movedType;     //type before the move, so a promoted piece goes back as a pawn
+    Piece captured;          //piece on the target square; empty for en passant
+    uint8_t castlingMoved;   //the six king and rook moved flags, see ChessBoard::castlingFlags
+    Position enPassantTarget;
+    int halfmoveClock;
+    int fullmoveNumber;
+    uint64_t hashKey;
+};
+
+//ply-indexed undo records of the moves played with doMove. A copied board starts with an empty
+//stack, so copy-make never copies or allocates history.
+class StateStack {
+public:
+    StateStack() {}
+    StateStack(const StateStack&) {}
+    
+    StateStack& operator=(const StateStack&) {
+        states.clear();
+        return *this;
+    }
+    
+    StateInfo& push() {
+        states.emplace_back();
+        return states.back();
+    }
+    
+    const StateInfo& top() const {
+        return states.back();
+    }
+    
+    void pop() {
+        states.pop_back();
+    }
+    
+    void clear() {
+        states.clear();
+    }
+    
+    int size() const {
+        return static_cast<int>(states.size());
+    }
+    
+private:
+    std::vector<StateInfo> states;
+};
+
+class ChessBoard {
+private:
+    Bitboard pieceBB[7];   //indexed by PieceType, EMPTY slot unused
+    Bitboard colorBB[3];   //indexed by Color, NONE slot unused
+    PieceType mailbox[64]; //piece type on each square, colors live in colorBB
+    Color currentPlayer;
+    bool whiteKingMoved;
+    bool blackKingMoved;
+    bool whiteQueenRookMoved;
+    bool whiteKingRookMoved;
+    bool blackQueenRookMoved;
+    bool blackKingRookMoved;
+    Position enPassantTarget;
+    uint64_t hashKey;      //Zobrist key, kept up to date by putPiece, switchPlayer and executeMove, restored by undoMove
+    int halfmoveClock;     //plies since the last capture or pawn move
+    int fullmoveNumber;    //starts at 1, incremented after each black move
+    int materialScore[2];  //middlegame and endgame material plus piece-square sums for white, kept by putPiece
+    int gamePhase;         //sum of phaseWeights of the pieces on the board, kept by putPiece
+    StateStack stateStack; //one undo record per move played with doMove
+    mutable GameStatus cachedStatus;
+    mutable bool statusValid; //cleared by every board change, see putPiece and switchPlayer
+    
+public:
+    ChessBoard() : currentPlayer(Color::WHITE), 
+                  whiteKingMoved(false), blackKingMoved(false),
+                  whiteQueenRookMoved(false), whiteKingRookMoved(false),
+                  blackQueenRookMoved(false), blackKingRookMoved(false),
+                  enPassantTarget(Position(-1, -1)), hashKey(0), halfmoveClock(0), fullmoveNumber(1),
+                  materialScore{0, 0}, gamePhase(0), statusValid(false) {
+        resetBoard();
+    }
+    
+    void resetBoard() {
+        clearBoard();
+        
+        //pawns
+        for (int col = 0; col < 8; col++) {
+            setPiece(Position(1, col), Piece(PieceType::PAWN, Color::BLACK));
+            setPiece(Position(6, col), Piece(PieceType::PAWN, Color::WHITE));
+        }
+        
+        //rooks
+        setPiece(Position(0, 0), Piece(PieceType::ROOK, Color::BLACK));
+        setPiece(Position(0, 7), Piece(PieceType::ROOK, Color::BLACK));
+        setPiece(Position(7, 0), Piece(PieceType::ROOK, Color::WHITE));
+        setPiece(Position(7, 7), Piece(PieceType::ROOK, Color::WHITE));
+        
+        //knights
+        setPiece(Position(0, 1), Piece(PieceType::KNIGHT, Color::BLACK));
+        setPiece(Position(0, 6), Piece(PieceType::KNIGHT, Color::BLACK));
+        setPiece(Position(7, 1), Piece(PieceType::KNIGHT, Color::WHITE));
+        setPiece(Position(7, 6), Piece(PieceType::KNIGHT, Color::WHITE));
+        
+        //bishops
+        setPiece(Position(0, 2), Piece(PieceType::BISHOP, Color::BLACK));
+        setPiece(Position(0, 5), Piece(PieceType::BISHOP, Color::BLACK));
+        setPiece(Position(7, 2), Piece(PieceType::BISHOP, Color::WHITE));
+        setPiece(Position(7, 5), Piece(PieceType::BISHOP, Color::WHITE));
+        
+        //queens
+        setPiece(Position(0, 3), Piece(PieceType::QUEEN, Color::BLACK));
+        setPiece(Position(7, 3), Piece(PieceType::QUEEN, Color::WHITE));
+        
+        //kings
+        setPiece(Position(0, 4), Piece(PieceType::KING, Color::BLACK));
+        setPiece(Position(7, 4), Piece(PieceType::KING, Color::WHITE));
+        
+        //reset state variables
+        currentPlayer = Color::WHITE;
+        whiteKingMoved = false;
+        blackKingMoved = false;
+        whiteQueenRookMoved = false;
+        whiteKingRookMoved = false;
+        blackQueenRookMoved = false;
+        blackKingRookMoved = false;
+        enPassantTarget = Position(-1, -1);
+        halfmoveClock = 0;
+        fullmoveNumber = 1;
+        hashKey = computeHash();
+    }
+    
+    void clearBoard() {
+        for (int i = 0; i < 7; i++) {
+            pieceBB[i] = 0;
+        }
+        for (int i = 0; i < 3; i++) {
+            colorBB[i] = 0;
+        }
+        for (int sq = 0; sq < 64; sq++) {
+            mailbox[sq] = PieceType::EMPTY;
+        }
+        materialScore[0] = materialScore[1] = 0;
+        gamePhase = 0;
+        stateStack.clear();
+        hashKey = computeHash();
+        statusValid = false;
+    }
+    
+    //load a position from Forsyth-Edwards Notation; the board is left untouched on malformed input.
+    //Parses in place over the view, so batch loaders can hand in slices of a larger buffer.
+    bool fromFEN(std::string_view fen) {
+        ChessBoard parsed(*this);
+        parsed.clearBoard();
+        size_t i = 0;
+        
+        //piece placement, rank 8 first
+        int row = 0;
+        int col = 0;
+        for (; i < fen.size() && fen[i] != ' '; i++) {
+            char c = fen[i];
+            if (c == '/') {
+                if (col != 8) return false;
+                row++;
+                col = 0;
+            } else if (c >= '1' && c <= '8') {
+                col += c - '0';
+                if (col > 8) return false;
+            } else {
+                PieceType type;
+                switch (std::tolower(c)) {
+                    case 'p': type = PieceType::PAWN; break;
+                    case 'n': type = PieceType::KNIGHT; break;
+                    case 'b': type = PieceType::BISHOP; break;
+                    case 'r': type = PieceType::ROOK; break;
+                    case 'q': type = PieceType::QUEEN; break;
+                    case 'k': type = PieceType::KING; break;
+                    default: return false;
+                }
+                if (row > 7 || col > 7) return false;
+                if (type == PieceType::PAWN && (row == 0 || row == 7)) return false;
+                parsed.setPiece(Position(row, col), Piece(type, std::isupper(c) ? Color::WHITE : Color::BLACK));
+                col++;
+            }
+        }
+        if (row != 7 || col != 8) return false;
+        if (popCount(parsed.pieces(PieceType::KING, Color::WHITE)) != 1 ||
+            popCount(parsed.pieces(PieceType::KING, Color::BLACK)) != 1) return false;
+        
+        //side to move
+        skipSpaces(fen, i);
+        if (i >= fen.size() || (fen[i] != 'w' && fen[i] != 'b')) return false;
+        parsed.currentPlayer = (fen[i++] == 'w') ? Color::WHITE : Color::BLACK;
+        if (parsed.isCheck(opposite(parsed.currentPlayer))) return false;
+        
+        //castling rights map onto the moved flags: a missing right means that rook (or the king) has moved
+        bool rights[4] = { false, false, false, false };
+        skipSpaces(fen, i);
+        for (; i < fen.size() && fen[i] != ' '; i++) {
+            switch (fen[i]) {
+                case 'K': rights[0] = true; break;
+                case 'Q': rights[1] = true; break;
+                case 'k': rights[2] = true; break;
+                case 'q': rights[3] = true; break;
+                case '-': break;
+                default: return false;
+            }
+        }
+        //a right only stands while its king and rook are still on their starting squares
+        Bitboard whiteKing = parsed.pieces(PieceType::KING, Color::WHITE) & squareBB(4);
+        Bitboard blackKing = parsed.pieces(PieceType::KING, Color::BLACK) & squareBB(60);
+        Bitboard whiteRooks = parsed.pieces(PieceType::ROOK, Color::WHITE);
+        Bitboard blackRooks = parsed.pieces(PieceType::ROOK, Color::BLACK);
+        rights[0] = rights[0] && whiteKing && (whiteRooks & squareBB(7));
+        rights[1] = rights[1] && whiteKing && (whiteRooks & squareBB(0));
+        rights[2] = rights[2] && blackKing && (blackRooks & squareBB(63));
+        rights[3] = rights[3] && blackKing && (blackRooks & squareBB(56));
+        parsed.whiteKingRookMoved = !rights[0];
+        parsed.whiteQueenRookMoved = !rights[1];
+        parsed.whiteKingMoved = !rights[0] && !rights[1];
+        parsed.blackKingRookMoved = !rights[2];
+        parsed.blackQueenRookMoved = !rights[3];
+        parsed.blackKingMoved = !rights[2] && !rights[3];
+        
+        //en passant target square
+        parsed.enPassantTarget = Position(-1, -1);
+        skipSpaces(fen, i);
+        if (i < fen.size() && fen[i] == '-') {
+            i++;
+        } else if (i < fen.size()) {
+            //the square behind a pawn that just moved two: rank 6 with White to move, rank 3 with Black
+            if (i + 1 >= fen.size() || (i + 2 < fen.size() && fen[i + 2] != ' ')) return false;
+            Position target(8 - (fen[i + 1] - '0'), fen[i] - 'a');
+            if (!target.isValid() || target.row != (parsed.currentPlayer == Color::WHITE ? 2 : 5)) return false;
+            //the pawn stands in front of the target, and the target and the square it came from are empty
+            int targetSq = toSquare(target);
+            int forward = (parsed.currentPlayer == Color::WHITE) ? 8 : -8;
+            if ((parsed.occupied() & (squareBB(targetSq) | squareBB(targetSq + forward))) ||
+                !(parsed.pieces(PieceType::PAWN, opposite(parsed.currentPlayer)) & squareBB(targetSq - forward))) {
+                return false;
+            }
+            parsed.enPassantTarget = target;
+            i += 2;
+        }
+        
+        //halfmove clock and fullmove number are optional, as in many EPD files
+        parsed.halfmoveClock = 0;
+        parsed.fullmoveNumber = 1;
+        skipSpaces(fen, i);
+        if (i < fen.size() && std::isdigit(static_cast<unsigned char>(fen[i]))) {
+            parsed.halfmoveClock = parseNumber(fen, i);
+            skipSpaces(fen, i);
+            if (i < fen.size() && std::isdigit(static_cast<unsigned char>(fen[i]))) {
+                parsed.fullmoveNumber = std::max(1, parseNumber(fen, i));
+            }
+        }
+        
+        parsed.hashKey = parsed.computeHash();
+        *this = parsed;
+        return true;
+    }
+    
+    std::string toFEN() const {
+        std::string fen;
+        fen.reserve(90);
+        for (int row = 0; row < 8; row++) {
+            int emptySquares = 0;
+            for (int col = 0; col < 8; col++) {
+                Piece piece = getPiece(Position(row, col));
+                if (piece.type == PieceType::EMPTY) {
+                    emptySquares++;
+                    continue;
+                }
+                if (emptySquares > 0) {
+                    fen += static_cast<char>('0' + emptySquares);
+                    emptySquares = 0;
+                }
+                fen += piece.getSymbol();
+            }
+            if (emptySquares > 0) {
+                fen += static_cast<char>('0' + emptySquares);
+            }
+            if (row < 7) fen += '/';
+        }
+        
+        fen += (currentPlayer == Color::WHITE) ? " w " : " b ";
+        size_t castlingStart = fen.size();
+        if (!whiteKingMoved && !whiteKingRookMoved) fen += 'K';
+        if (!whiteKingMoved && !whiteQueenRookMoved) fen += 'Q';
+        if (!blackKingMoved && !blackKingRookMoved) fen += 'k';
+        if (!blackKingMoved && !blackQueenRookMoved) fen += 'q';
+        if (fen.size() == castlingStart) fen += '-';
+        
+        fen += ' ';
+        fen += enPassantTarget.isValid() ? enPassantTarget.toAlgebraic() : "-";
+        fen += ' ';
+        fen += std::to_string(halfmoveClock);
+        fen += ' ';
+        fen += std::to_string(fullmoveNumber);
+        return fen;
+    }
+    
+    void displayBoard() const {
+        std::cout << "  +---+---+---+---+---+---+---+---+" << std::endl;
+        for (int row = 0; row < 8; row++) {
+            std::cout << (8 - row) << " |";
+            for (int col = 0; col < 8; col++) {
+                std::cout << " " << getPiece(Position(row, col)).getSymbol() << " |";
+            }
+            std::cout << std::endl << "  +---+---+---+---+---+---+---+---+" << std::endl;
+        }
+        std::cout << "    a   b   c   d   e   f   g   h  " << std::endl;
+    }
+    
+    Piece getPiece(const Position& pos) const {
+        if (!pos.isValid()) return Piece();
+        return pieceAt(toSquare(pos));
+    }
+    
+    Piece pieceAt(int sq) const {
+        PieceType type = mailbox[sq];
+        if (type == PieceType::EMPTY) return Piece();
+        return Piece(type, (colorBB[static_cast<int>(Color::WHITE)] & squareBB(sq)) ? Color::WHITE : Color::BLACK);
+    }
+    
+    void setPiece(const Position& pos, const Piece& piece) {
+        if (pos.isValid()) {
+            putPiece(toSquare(pos), piece);
+        }
+    }
+    
+    void putPiece(int sq, const Piece& piece) {
+        Bitboard bit = squareBB(sq);
+        statusValid = false;
+        PieceType oldType = mailbox[sq];
+        if (oldType != PieceType::EMPTY) {
+            Color oldColor = (colorBB[static_cast<int>(Color::WHITE)] & bit) ? Color::WHITE : Color::BLACK;
+            hashKey ^= zobristKeys.pieces[static_cast<int>(oldColor)][static_cast<int>(oldType)][sq];
+            materialScore[0] -= evalTables.score[0][static_cast<int>(oldColor)][static_cast<int>(oldType)][sq];
+            materialScore[1] -= evalTables.score[1][static_cast<int>(oldColor)][static_cast<int>(oldType)][sq];
+            gamePhase -= phaseWeights[static_cast<int>(oldType)];
+            pieceBB[static_cast<int>(oldType)] &= ~bit;
+            colorBB[static_cast<int>(Color::WHITE)] &= ~bit;
+            colorBB[static_cast<int>(Color::BLACK)] &= ~bit;
+        }
+        mailbox[sq] = piece.type;
+        if (piece.type != PieceType::EMPTY) {
+            pieceBB[static_cast<int>(piece.type)] |= bit;
+            colorBB[static_cast<int>(piece.color)] |= bit;
+            hashKey ^= zobristKeys.pieces[static_cast<int>(piece.color)][static_cast<int>(piece.type)][sq];
+            materialScore[0] += evalTables.score[0][static_cast<int>(piece.color)][static_cast<int>(piece.type)][sq];
+            materialScore[1] += evalTables.score[1][static_cast<int>(piece.color)][static_cast<int>(piece.type)][sq];
+            gamePhase += phaseWeights[static_cast<int>(piece.type)];
+        }
+    }
+    
+    Bitboard pieces(PieceType type) const {
+        return pieceBB[static_cast<int>(type)];
+    }
+    
+    Bitboard pieces(Color color) const {
+        return colorBB[static_cast<int>(color)];
+    }
+    
+    Bitboard pieces(PieceType type, Color color) const {
+        return pieceBB[static_cast<int>(type)] & colorBB[static_cast<int>(color)];
+    }
+    
+    Bitboard occupied() const {
+        return colorBB[static_cast<int>(Color::WHITE)] | colorBB[static_cast<int>(Color::BLACK)];
+    }
+    
+    Color getCurrentPlayer() const {
+        return currentPlayer;
+    }
+    
+    void switchPlayer() {
+        currentPlayer = (currentPlayer == Color::WHITE) ? Color::BLACK : Color::WHITE;
+        hashKey ^= zobristKeys.blackToMove;
+        statusValid = false;
+    }
+    
+    uint64_t getHash() const {
+        return hashKey;
+    }
+    
+    //getHash without the en passant file when no pawn can take there, so a position reached by
+    //different move orders gets one key; the position index is keyed on this
+    uint64_t positionKey() const {
+        uint64_t key = hashKey;
+        if (enPassantTarget.isValid() &&
+            !(attackTables.pawn[static_cast<int>(opposite(currentPlayer))][toSquare(enPassantTarget)] &
+              pieces(PieceType::PAWN, currentPlayer))) {
+            key ^= zobristKeys.enPassantFile[enPassantTarget.col];
+        }
+        return key;
+    }
+    
+    int getHalfmoveClock() const {
+        return halfmoveClock;
+    }
+    
+    int getFullmoveNumber() const {
+        return fullmoveNumber;
+    }
+    
+    //castling rights and en passant file; XORed out before and back in after they change
+    uint64_t stateKey() const {
+        uint64_t key = 0;
+        if (!whiteKingMoved && !whiteKingRookMoved) key ^= zobristKeys.castling[0];
+        if (!whiteKingMoved && !whiteQueenRookMoved) key ^= zobristKeys.castling[1];
+        if (!blackKingMoved && !blackKingRookMoved) key ^= zobristKeys.castling[2];
+        if (!blackKingMoved && !blackQueenRookMoved) key ^= zobristKeys.castling[3];
+        if (enPassantTarget.isValid()) key ^= zobristKeys.enPassantFile[enPassantTarget.col];
+        return key;
+    }
+    
+    //full recomputation, used on setup and to cross-check the incremental key
+    uint64_t computeHash() const {
+        uint64_t key = stateKey();
+        if (currentPlayer == Color::BLACK) key ^= zobristKeys.blackToMove;
+        Bitboard occupancy = occupied();
+        while (occupancy) {
+            int sq = popLsb(occupancy);
+            Piece piece = pieceAt(sq);
+            key ^= zobristKeys.pieces[static_cast<int>(piece.color)][static_cast<int>(piece.type)][sq];
+        }
+        return key;
+    }
+    
+    //with CHESS_DEBUG_HASH defined every make/undo checks the incremental key against a full rehash
+    void verifyHash() const {
+#ifdef CHESS_DEBUG_HASH
+        assert(hashKey == computeHash() && "incremental Zobrist key out of sync");
+#endif
+    }
+    
+    //full recomputation of the white-signed middlegame (phase 0) or endgame (phase 1) score
+    int computeMaterial(int phase) const {
+        int score = 0;
+        Bitboard occupancy = occupied();
+        while (occupancy) {
+            int sq = popLsb(occupancy);
+            Piece piece = pieceAt(sq);
+            score += evalTables.score[phase][static_cast<int>(piece.color)][static_cast<int>(piece.type)][sq];
+        }
+        return score;
+    }
+    
+    //with CHESS_DEBUG_EVAL defined every make/undo checks the incremental scores against a full recount
+    void verifyEval() const {
+#ifdef CHESS_DEBUG_EVAL
+        int phase = 0;
+        for (int type = 1; type < 7; type++) {
+            phase += phaseWeights[type] * popCount(pieceBB[type]);
+        }
+        assert(materialScore[0] == computeMaterial(0) && materialScore[1] == computeMaterial(1) &&
+               gamePhase == phase && "incremental evaluation out of sync");
+#endif
+    }
+    
+    Position findKing(Color color) const {
+        Bitboard kings = pieces(PieceType::KING, color);
+        if (!kings) {
+            return Position(-1, -1); // King not found
+        }
+        return fromSquare(lsb(kings));
+    }
+    
+    bool isCheck(Color color) const {
+        Bitboard kings = pieces(PieceType::KING, color);
+        return kings && isSquareAttacked(lsb(kings), opposite(color));
+    }
+    
+    bool isPositionUnderAttack(const Position& pos, Color defendingColor) const {
+        return pos.isValid() && isSquareAttacked(toSquare(pos), opposite(defendingColor));
+    }
+    
+    //yes/no attack query: table lookups only, cheapest attackers first so most calls exit early
+    bool isSquareAttacked(int sq, Color attackingColor) const {
+        Bitboard attackers = pieces(attackingColor);
+        Bitboard occupancy = occupied();
+        
+        //pawn attacks: look from the target square the way a defending pawn would capture
+        if (attackTables.pawn[static_cast<int>(opposite(attackingColor))][sq] & pieces(PieceType::PAWN) & attackers) {
+            return true;
+        }
+        
+        //knight and king attacks
+        if ((attackTables.knight[sq] & pieces(PieceType::KNIGHT) & attackers) ||
+            (attackTables.king[sq] & pieces(PieceType::KING) & attackers)) {
+            return true;
+        }
+        
+        //sliding pieces
+        Bitboard queens = pieces(PieceType::QUEEN);
+        if (bishopAttacks(sq, occupancy) & (pieces(PieceType::BISHOP) | queens) & attackers) {
+            return true;
+        }
+        return (rookAttacks(sq, occupancy) & (pieces(PieceType::ROOK) | queens) & attackers) != 0;
+    }
+    
+    bool makeMove(const Move& move) {
+        if (!move.from().isValid() || !move.to().isValid()) {
+            return false;
+        }
+        Piece piece = getPiece(move.from());
+        
+        //check if the piece belongs to the current player
+        if (piece.color != currentPlayer) {
+            return false;
+        }
+        //check if the move is valid for this piece
+        if (!isValidMove(move)) {
+            return false;
+        }
+        
+        //a move that puts or leaves the player's king in check is taken back
+        Color mover = currentPlayer;
+        doMove(move);
+        if (isCheck(mover)) {
+            undoMove();
+            return false;
+        }
+        return true;
+    }
+    
+    //play a move already known to be legal and hand the turn over; undoMove takes it back
+    void doMove(const Move& move) {
+        StateInfo& state = stateStack.push();
+        state.move = move;
+        state.movedType = mailbox[move.fromSq()];
+        state.captured = getPiece(move.to());
+        state.castlingMoved = castlingFlags();
+        state.enPassantTarget = enPassantTarget;
+        state.halfmoveClock = halfmoveClock;
+        state.fullmoveNumber = fullmoveNumber;
+        state.hashKey = hashKey;
+        playMove(move);
+    }
+    
+    //doMove without an undo record, for callers that copy the board instead (copy-make)
+    void playMove(const Move& move) {
+        updateHalfmoveClock(getPiece(move.from()), getPiece(move.to()));
+        executeMove(move);
+        switchPlayer();
+    }
+    
+    //take back the last move played with doMove
+    void undoMove() {
+        const StateInfo& state = stateStack.top();
+        switchPlayer();
+        Color us = currentPlayer;
+        int fromSq = state.move.fromSq();
+        int toSq = state.move.toSq();
+        putPiece(fromSq, Piece(state.movedType, us));
+        putPiece(toSq, state.captured);
+        
+        //castling: the rook goes back to its corner
+        if (state.movedType == PieceType::KING && std::abs(toSq - fromSq) == 2) {
+            bool kingSide = toSq > fromSq;
+            int rookFrom = kingSide ? toSq + 1 : toSq - 2;
+            int rookTo = kingSide ? toSq - 1 : toSq + 1;
+            putPiece(rookFrom, Piece(PieceType::ROOK, us));
+            putPiece(rookTo, Piece());
+        }
+        
+        //en passant: the captured pawn was beside the target square
+        if (state.movedType == PieceType::PAWN && state.enPassantTarget.isValid() &&
+            toSq == toSquare(state.enPassantTarget)) {
+            putPiece(toSq + ((us == Color::WHITE) ? -8 : 8), Piece(PieceType::PAWN, opposite(us)));
+        }
+        
+        setCastlingFlags(state.castlingMoved);
+        enPassantTarget = state.enPassantTarget;
+        halfmoveClock = state.halfmoveClock;
+        fullmoveNumber = state.fullmoveNumber;
+        hashKey = state.hashKey;
+        stateStack.pop();
+        verifyHash();
+        verifyEval();
+    }
+    
+    //number of moves that undoMove can take back
+    int undoDepth() const {
+        return stateStack.size();
+    }
+    
+    //the six moved flags as bits: white king, white queen rook, white king rook, then black
+    uint8_t castlingFlags() const {
+        return static_cast<uint8_t>(whiteKingMoved | (whiteQueenRookMoved << 1) | (whiteKingRookMoved << 2) |
+                                    (blackKingMoved << 3) | (blackQueenRookMoved << 4) | (blackKingRookMoved << 5));
+    }
+    
+    void setCastlingFlags(uint8_t flags) {
+        whiteKingMoved = flags & 1;
+        whiteQueenRookMoved = flags & 2;
+        whiteKingRookMoved = flags & 4;
+        blackKingMoved = flags & 8;
+        blackQueenRookMoved = flags & 16;
+        blackKingRookMoved = flags & 32;
+    }
+    
+    //the clocks advance per turn, so only playMove touches them, never executeMove; undoMove restores them
+    void updateHalfmoveClock(const Piece& moved, const Piece& captured) {
+        if (moved.type == PieceType::PAWN || captured.type != PieceType::EMPTY) {
+            halfmoveClock = 0;
+        } else {
+            halfmoveClock++;
+        }
+        if (moved.color == Color::BLACK) {
+            fullmoveNumber++;
+        }
+    }
+    
+    bool isValidMove(const Move& move) const {
+        Piece piece = getPiece(move.from());
+        Piece targetPiece = getPiece(move.to());
+        
+        //can't capture own piece
+        if (targetPiece.type != PieceType::EMPTY && targetPiece.color == piece.color) {
+            return false;
+        }
+        
+        switch (piece.type) {
+            case PieceType::PAWN:
+                return isValidPawnMove(move);
+            case PieceType::KNIGHT:
+                return isValidKnightMove(move);
+            case PieceType::BISHOP:
+                return isValidBishopMove(move);
+            case PieceType::ROOK:
+                return isValidRookMove(move);
+            case PieceType::QUEEN:
+                return isValidQueenMove(move);
+            case PieceType::KING:
+                return isValidKingMove(move);
+            default:
+                return false;
+        }
+    }
+    
+    bool isValidPawnMove(const Move& move) const {
+        Piece pawn = getPiece(move.from());
+        Piece targetPiece = getPiece(move.to());
+        
+        int direction = (pawn.color == Color::WHITE) ? -1 : 1;
+        int startRow = (pawn.color == Color::WHITE) ? 6 : 1;
+        
+        //regular move forward
+        if (move.from().col == move.to().col) {
+            // Single step forward
+            if (move.to().row == move.from().row + direction) {
+                return targetPiece.type == PieceType::EMPTY;
+            }
+            //double step from starting position
+            if (move.from().row == startRow && move.to().row == move.from().row + 2 * direction) {
+                Position intermediate(move.from().row + direction, move.from().col);
+                return targetPiece.type == PieceType::EMPTY && 
+                       getPiece(intermediate).type == PieceType::EMPTY;
+            }
+        }
+        else if (abs(move.to().col - move.from().col) == 1 && move.to().row == move.from().row + direction) {
+            //regular capture
+            if (targetPiece.type != PieceType::EMPTY && targetPiece.color != pawn.color) {
+                return true;
+            }
+            //en passant capture
+            if (targetPiece.type == PieceType::EMPTY && move.to() == enPassantTarget) {
+                return true;
+            }
+        }
+        
+        return false;
+    }
+    
+    bool isValidKnightMove(const Move& move) const {
+        int rowDiff = abs(move.to().row - move.from().row);
+        int colDiff = abs(move.to().col - move.from().col);
+        
+        return (rowDiff == 2 && colDiff == 1) || (rowDiff == 1 && colDiff == 2);
+    }
+    
+    bool isValidBishopMove(const Move& move) const {
+        if (!move.from().isValid() || !move.to().isValid()) return false;
+        //the attack set already stops at the first blocker on each diagonal
+        return (bishopAttacks(move.fromSq(), occupied()) & squareBB(move.toSq())) != 0;
+    }
+    
+    bool isValidRookMove(const Move& move) const {
+        if (!move.from().isValid() || !move.to().isValid()) return false;
+        return (rookAttacks(move.fromSq(), occupied()) & squareBB(move.toSq())) != 0;
+    }
+    
+    bool isValidQueenMove(const Move& move) const {
+        return isValidBishopMove(move) || isValidRookMove(move);
+    }
+    
+    bool isValidKingMove(const Move& move) const {
+        Piece king = getPiece(move.from());
+        int rowDiff = abs(move.to().row - move.from().row);
+        int colDiff = abs(move.to().col - move.from().col);
+        
+        //Normal king move
+        if (rowDiff <= 1 && colDiff <= 1) {
+            return true;
+        }
+        
+        //castling
+        if (rowDiff == 0 && colDiff == 2) {
+            // Check if the king has already moved
+            if ((king.color == Color::WHITE && whiteKingMoved) || 
+                (king.color == Color::BLACK && blackKingMoved)) {
+                return false;
+            }
+            if (isCheck(king.color)) {
+                return false;
+            }
+          
+            int row = move.from().row;
+            
+            //king-side castling
+            if (move.to().col == 6) {
+                //check if the rook has moved
+                if ((king.color == Color::WHITE && whiteKingRookMoved) ||
+                    (king.color == Color::BLACK && blackKingRookMoved)) {
+                    return false;
+                }
+                
+                // Check if the path is clear
+                if (getPiece(Position(row, 5)).type != PieceType::EMPTY || 
+                    getPiece(Position(row, 6)).type != PieceType::EMPTY) {
+                    return false;
+                }
+                
+                //check if the squares the king passes through are under attack
+                if (isPositionUnderAttack(Position(row, 5), king.color)) {
+                    return false;
+                }
+                
+                //check ifrook is in place
+                Piece rook = getPiece(Position(row, 7));
+                return rook.type == PieceType::ROOK && rook.color == king.color;
+            }
+            //queen-side castling
+            else if (move.to().col == 2) {
+                // Check if the rook has moved
+                if ((king.color == Color::WHITE && whiteQueenRookMoved) ||
+                    (king.color == Color::BLACK && blackQueenRookMoved)) {
+                    return false;
+                }
+                if (getPiece(Position(row, 1)).type != PieceType::EMPTY || 
+                    getPiece(Position(row, 2)).type != PieceType::EMPTY ||
+                    getPiece(Position(row, 3)).type != PieceType::EMPTY) {
+                    return false;
+                }
+                if (isPositionUnderAttack(Position(row, 3), king.color)) {
+                    return false;
+                }
+                Piece rook = getPiece(Position(row, 0));
+                return rook.type == PieceType::ROOK && rook.color == king.color;
+            }
+        }
+        
+        return false;
+    }
+    
+    //every piece of attackingColor attacking sq, for check detection and exchange evaluation
+    Bitboard attackersTo(int sq, Color attackingColor) const {
+        return attackersTo(sq, occupied()) & pieces(attackingColor);
+    }
+    
+    //enemy pieces giving check to the side to move
+    Bitboard checkers() const {
+        Bitboard kings = pieces(PieceType::KING, currentPlayer);
+        return kings ? attackersTo(lsb(kings), opposite(currentPlayer)) : 0;
+    }
+    
+    //every piece of either color that attacks sq, given an occupancy
+    Bitboard attackersTo(int sq, Bitboard occupancy) const {
+        Bitboard queens = pieces(PieceType::QUEEN);
+        return (attackTables.pawn[static_cast<int>(Color::WHITE)][sq] & pieces(PieceType::PAWN, Color::BLACK)) |
+               (attackTables.pawn[static_cast<int>(Color::BLACK)][sq] & pieces(PieceType::PAWN, Color::WHITE)) |
+               (attackTables.knight[sq] & pieces(PieceType::KNIGHT)) |
+               (attackTables.king[sq] & pieces(PieceType::KING)) |
+               (bishopAttacks(sq, occupancy) & (pieces(PieceType::BISHOP) | queens)) |
+               (rookAttacks(sq, occupancy) & (pieces(PieceType::ROOK) | queens));
+    }
+    
+    //own pieces that are the only blocker between the own king and an enemy slider
+    Bitboard pinnedPieces(Color color) const {
+        Bitboard kings = pieces(PieceType::KING, color);
+        if (!kings) return 0;
+        int kingSq = lsb(kings);
+        Bitboard occupancy = occupied();
+        Bitboard queens = pieces(PieceType::QUEEN);
+        Bitboard snipers = ((rookAttacks(kingSq, 0) & (pieces(PieceType::ROOK) | queens)) |
+                            (bishopAttacks(kingSq, 0) & (pieces(PieceType::BISHOP) | queens))) &
+                           pieces(opposite(color));
+        Bitboard pinned = 0;
+        while (snipers) {
+            Bitboard blockers = attackTables.between[kingSq][popLsb(snipers)] & occupancy;
+            if (blockers && !(blockers & (blockers - 1))) {
+                pinned |= blockers & pieces(color);
+            }
+        }
+        return pinned;
+    }
+    
+    //every move the pieces can physically make, ignoring whether the own king is left in check
+    void generatePseudoLegalMoves(MoveList& moveList, GenType type = GenType::ALL) const {
+        Color us = currentPlayer;
+        Bitboard own = pieces(us);
+        generatePieceMoves(moveList, ~own, 0, type);
+        
+        Bitboard kings = pieces(PieceType::KING, us);
+        if (kings) {
+            int kingSq = lsb(kings);
+            addMoves(moveList, kingSq, attackTables.king[kingSq] & typeMask(type));
+            if (type != GenType::CAPTURES && !isCheck(us)) {
+                generateCastlingMoves(moveList, kingSq);
+            }
+        }
+    }
+    
+    //legal moves only: checkers and pins are worked out once, so no candidate has to be played
+    void generateLegalMoves(MoveList& moveList, GenType type = GenType::ALL) const {
+        Color us = currentPlayer;
+        Bitboard kings = pieces(PieceType::KING, us);
+        if (!kings) {
+            //without a king nothing can be left in check
+            generatePseudoLegalMoves(moveList, type);
+            return;
+        }
+        int kingSq = lsb(kings);
+        Bitboard own = pieces(us);
+        Bitboard enemy = pieces(opposite(us));
+        Bitboard occupancy = own | enemy;
+        Bitboard checkers = attackersTo(kingSq, occupancy) & enemy;
+        
+        //the king may not step onto an attacked square, nor slide back along a checking ray
+        Bitboard kingTargets = attackTables.king[kingSq] & typeMask(type);
+        Bitboard withoutKing = occupancy ^ squareBB(kingSq);
+        while (kingTargets) {
+            int toSq = popLsb(kingTargets);
+            if (!(attackersTo(toSq, withoutKing) & enemy)) {
+                moveList.add(Move(kingSq, toSq));
+            }
+        }
+        
+        //in double check only the king can move
+        if (checkers & (checkers - 1)) {
+            return;
+        }
+        
+        //in single check the other pieces must capture the checker or block its ray
+        Bitboard targetMask = ~own;
+        if (checkers) {
+            targetMask &= checkers | attackTables.between[kingSq][lsb(checkers)];
+        } else if (type != GenType::CAPTURES) {
+            generateCastlingMoves(moveList, kingSq);
+        }
+        generatePieceMoves(moveList, targetMask, pinnedPieces(us), type);
+    }
+    
+    //the legal move that text input such as "e1g1" or "e7e8q" stands for: castling and en passant
+    //are recognised by matching from and to against the generated moves, and a promotion given
+    //without a piece becomes a queen
+    bool resolveMove(const Move& input, Move& legal) const {
+        MoveList moveList;
+        generateLegalMoves(moveList);
+        for (const Move& move : moveList) {
+            if (move.fromSq() == input.fromSq() && move.toSq() == input.toSq() &&
+                (move.promotion() == input.promotion() ||
+                 (input.promotion() == PieceType::EMPTY && move.promotion() == PieceType::QUEEN))) {
+                legal = move;
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    //coordinate notation ("e2e4", "e7e8q") to the legal move it names, as used by UCI
+    bool parseMove(std::string_view text, Move& legal) const {
+        if (text.size() < 4 || text.size() > 5) return false;
+        Position from = Position::fromAlgebraic(std::string(text.substr(0, 2)));
+        Position to = Position::fromAlgebraic(std::string(text.substr(2, 2)));
+        if (!from.isValid() || !to.isValid()) return false;
+        PieceType promotion = PieceType::EMPTY;
+        if (text.size() == 5) {
+            switch (std::tolower(static_cast<unsigned char>(text[4]))) {
+                case 'q': promotion = PieceType::QUEEN; break;
+                case 'r': promotion = PieceType::ROOK; break;
+                case 'b': promotion = PieceType::BISHOP; break;
+                case 'n': promotion = PieceType::KNIGHT; break;
+                default: return false;
+            }
+        }
+        return resolveMove(Move(from, to, promotion), legal);
+    }
+    
+    //standard algebraic notation ("Nbd7", "exd6", "O-O-O", "e8=Q+") to the legal move it names.
+    //Only the pieces of the right type that reach the target square are tried, each with
+    //isLegalMove, so no move list is generated. Ambiguous or illegal moves are rejected.
+    bool parseSAN(std::string_view san, Move& legal) const {
+        while (!san.empty() && (san.back() == '+' || san.back() == '#' || san.back() == '!' || san.back() == '?')) {
+            san.remove_suffix(1);
+        }
+        Color us = currentPlayer;
+        if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0") {
+            int homeSq = (us == Color::WHITE) ? 4 : 60;
+            if (!(pieces(PieceType::KING, us) & squareBB(homeSq))) return false;
+            legal = Move(homeSq, homeSq + ((san.size() == 3) ? 2 : -2), Move::CASTLING);
+            return isLegalMove(legal);
+        }
+        
+        PieceType type = san.empty() ? PieceType::EMPTY : sanPieceType(san[0]);
+        if (type != PieceType::EMPTY) {
+            san.remove_prefix(1);
+        } else {
+            type = PieceType::PAWN;
+        }
+        PieceType promotion = PieceType::EMPTY;
+        size_t equals = san.find('=');
+        if (equals != std::string_view::npos) {
+            promotion = (equals + 2 == san.size()) ? sanPieceType(san[equals + 1]) : PieceType::EMPTY;
+            if (promotion == PieceType::EMPTY || promotion == PieceType::KING) return false;
+            san = san.substr(0, equals);
+        } else if (type == PieceType::PAWN && !san.empty() && sanPieceType(san.back()) != PieceType::EMPTY) {
+            promotion = sanPieceType(san.back());
+            san.remove_suffix(1);
+        }
+        if (san.size() < 2) return false;
+        int toFile = san[san.size() - 2] - 'a';
+        int toRank = san[san.size() - 1] - '1';
+        if (toFile < 0 || toFile > 7 || toRank < 0 || toRank > 7) return false;
+        int toSq = toRank * 8 + toFile;
+        san.remove_suffix(2);
+        
+        //whatever is left is disambiguation and the capture sign
+        Bitboard fromMask = ~0ULL;
+        bool capture = false;
+        for (char c : san) {
+            if (c >= 'a' && c <= 'h') {
+                fromMask &= 0x0101010101010101ULL << (c - 'a');
+            } else if (c >= '1' && c <= '8') {
+                fromMask &= 0xFFULL << (8 * (c - '1'));
+            } else if (c == 'x' || c == ':') {
+                capture = true;
+            } else {
+                return false;
+            }
+        }
+        
+        Bitboard candidates;
+        Move::Kind kind = (promotion != PieceType::EMPTY) ? Move::PROMOTION : Move::NORMAL;
+        if (type == PieceType::PAWN && !capture && fromMask == ~0ULL) {
+            int forward = (us == Color::WHITE) ? 8 : -8;
+            int oneBack = toSq - forward;
+            if (oneBack < 0 || oneBack > 63) return false;
+            candidates = pieces(PieceType::PAWN, us) & squareBB(oneBack);
+            if (!candidates && !(occupied() & squareBB(oneBack)) && oneBack - forward >= 0 && oneBack - forward < 64) {
+                candidates = pieces(PieceType::PAWN, us) & squareBB(oneBack - forward);
+            }
+        } else {
+            candidates = attackersTo(toSq, occupied()) & pieces(type, us) & fromMask;
+            if (type == PieceType::PAWN && enPassantTarget.isValid() && toSq == toSquare(enPassantTarget)) {
+                kind = Move::EN_PASSANT;
+            }
+        }
+        
+        int matches = 0;
+        while (candidates) {
+            Move move(popLsb(candidates), toSq, kind, (promotion != PieceType::EMPTY) ? promotion : PieceType::KNIGHT);
+            if (isLegalMove(move)) {
+                legal = move;
+                matches++;
+            }
+        }
+        return matches == 1;
+    }
+    
+    //a legal move in standard algebraic notation, disambiguated as little as possible and with
+    //a check or mate suffix
+    std::string toSAN(const Move& move) const {
+        int fromSq = move.fromSq();
+        int toSq = move.toSq();
+        PieceType type = mailbox[fromSq];
+        std::string san;
+        if (move.kind() == Move::CASTLING) {
+            san = (toSq > fromSq) ? "O-O" : "O-O-O";
+        } else {
+            bool capture = mailbox[toSq] != PieceType::EMPTY || move.kind() == Move::EN_PASSANT;
+            if (type == PieceType::PAWN) {
+                if (capture) san += static_cast<char>('a' + (fromSq & 7));
+            } else {
+                san += Piece(type, Color::WHITE).getSymbol();
+                Bitboard rivals = attackersTo(toSq, occupied()) & pieces(type, currentPlayer) & ~squareBB(fromSq);
+                bool ambiguous = false;
+                bool sameFile = false;
+                bool sameRank = false;
+                while (rivals) {
+                    int sq = popLsb(rivals);
+                    if (!isLegalMove(Move(sq, toSq))) continue;
+                    ambiguous = true;
+                    sameFile |= (sq & 7) == (fromSq & 7);
+                    sameRank |= (sq >> 3) == (fromSq >> 3);
+                }
+                if (ambiguous && (!sameFile || sameRank)) san += static_cast<char>('a' + (fromSq & 7));
+                if (ambiguous && sameFile) san += static_cast<char>('1' + (fromSq >> 3));
+            }
+            if (capture) san += 'x';
+            san += fromSquare(toSq).toAlgebraic();
+            if (move.promotion() != PieceType::EMPTY) {
+                san += '=';
+                san += Piece(move.promotion(), Color::WHITE).getSymbol();
+            }
+        }
+        ChessBoard next(*this);
+        next.playMove(move);
+        if (next.isCheck(next.currentPlayer)) {
+            san += next.hasLegalMoves() ? '+' : '#';
+        }
+        return san;
+    }
+    
+    //the position key of the Polyglot book format. Unlike getHash it counts an en passant file
+    //only when a pawn of the side to move can actually capture there.
+    uint64_t polyglotKey() const {
+        uint64_t key = 0;
+        Bitboard occupancy = occupied();
+        while (occupancy) {
+            int sq = popLsb(occupancy);
+            Piece piece = pieceAt(sq);
+            int kind = 2 * (static_cast<int>(piece.type) - 1) + (piece.color == Color::WHITE ? 1 : 0);
+            key ^= polyglotRandom.keys[64 * kind + sq];
+        }
+        if (!whiteKingMoved && !whiteKingRookMoved) key ^= polyglotRandom.keys[PolyglotRandom::CASTLING];
+        if (!whiteKingMoved && !whiteQueenRookMoved) key ^= polyglotRandom.keys[PolyglotRandom::CASTLING + 1];
+        if (!blackKingMoved && !blackKingRookMoved) key ^= polyglotRandom.keys[PolyglotRandom::CASTLING + 2];
+        if (!blackKingMoved && !blackQueenRookMoved) key ^= polyglotRandom.keys[PolyglotRandom::CASTLING + 3];
+        if (enPassantTarget.isValid() &&
+            (attackTables.pawn[static_cast<int>(opposite(currentPlayer))][toSquare(enPassantTarget)] &
+             pieces(PieceType::PAWN, currentPlayer))) {
+            key ^= polyglotRandom.keys[PolyglotRandom::EN_PASSANT + enPassantTarget.col];
+        }
+        if (currentPlayer == Color::WHITE) key ^= polyglotRandom.keys[PolyglotRandom::TURN];
+        return key;
+    }
+    
+    //Polyglot move encoding: to square in bits 0-5, from square in bits 6-11 (both a1 = 0, like
+    //ours), promotion knight..queen as 1-4 in bits 12-14, and castling as the king taking its rook
+    uint16_t toPolyglotMove(const Move& move) const {
+        int fromSq = move.fromSq();
+        int toSq = move.toSq();
+        if (move.kind() == Move::CASTLING) {
+            toSq = (toSq > fromSq) ? fromSq + 3 : fromSq - 4;
+        }
+        int promotion = (move.promotion() == PieceType::EMPTY)
+                            ? 0 : static_cast<int>(move.promotion()) - static_cast<int>(PieceType::KNIGHT) + 1;
+        return static_cast<uint16_t>(toSq | (fromSq << 6) | (promotion << 12));
+    }
+    
+    //the legal move a Polyglot move stands for in this position, checked with isLegalMove
+    bool fromPolyglotMove(uint16_t raw, Move& legal) const {
+        int toSq = raw & 63;
+        int fromSq = (raw >> 6) & 63;
+        int promotion = (raw >> 12) & 7;
+        if (promotion > 4) return false;
+        Move::Kind kind = Move::NORMAL;
+        if (promotion > 0) {
+            kind = Move::PROMOTION;
+        } else if (mailbox[fromSq] == PieceType::KING && (pieces(PieceType::ROOK, currentPlayer) & squareBB(toSq))) {
+            kind = Move::CASTLING;
+            toSq = (toSq > fromSq) ? fromSq + 2 : fromSq - 2;
+        } else if (mailbox[fromSq] == PieceType::PAWN && enPassantTarget.isValid() &&
+                   toSq == toSquare(enPassantTarget) && (fromSq & 7) != (toSq & 7)) {
+            kind = Move::EN_PASSANT;
+        }
+        PieceType piece = (promotion > 0) ? static_cast<PieceType>(static_cast<int>(PieceType::KNIGHT) + promotion - 1)
+                                          : PieceType::KNIGHT;
+        legal = Move(fromSq, toSq, kind, piece);
+        return isLegalMove(legal);
+    }
+    
+    //captures, en passant and promotions: the moves of the GenType::CAPTURES stage
+    bool isCapture(const Move& move) const {
+        return mailbox[move.toSq()] != PieceType::EMPTY || move.kind() == Move::PROMOTION ||
+               move.kind() == Move::EN_PASSANT;
+    }
+    
+    //whether a move from anywhere (a hash table, a killer slot, user input) is legal here,
+    //without generating the whole move list
+    bool isLegalMove(const Move& move) const {
+        if (move.isNull()) return false;
+        Color us = currentPlayer;
+        int fromSq = move.fromSq();
+        int toSq = move.toSq();
+        if (!(pieces(us) & squareBB(fromSq)) || (pieces(us) & squareBB(toSq))) return false;
+        
+        PieceType type = mailbox[fromSq];
+        //only promotions use the promotion bits, so every move has exactly one encoding
+        if ((move.kind() == Move::EN_PASSANT && type != PieceType::PAWN) ||
+            (move.kind() == Move::CASTLING && type != PieceType::KING) ||
+            (move.kind() != Move::PROMOTION && (move.raw() & 0x3000))) {
+            return false;
+        }
+        bool lastRank = (toSq >> 3) == ((us == Color::WHITE) ? 7 : 0);
+        if (type == PieceType::PAWN && lastRank) {
+            if (move.promotion() < PieceType::KNIGHT || move.promotion() > PieceType::QUEEN) return false;
+        } else if (move.promotion() != PieceType::EMPTY) {
+            return false;
+        }
+        
+        Bitboard occupancy = occupied();
+        Bitboard enemy = pieces(opposite(us));
+        Bitboard reach = 0;
+        switch (type) {
+            case PieceType::PAWN: {
+                if (move.kind() == Move::EN_PASSANT) {
+                    return enPassantTarget.isValid() && toSq == toSquare(enPassantTarget) &&
+                           (attackTables.pawn[static_cast<int>(us)][fromSq] & squareBB(toSq)) &&
+                           isLegalEnPassant(fromSq, toSq);
+                }
+                int forward = (us == Color::WHITE) ? 8 : -8;
+                int startRank = (us == Color::WHITE) ? 1 : 6;
+                reach = attackTables.pawn[static_cast<int>(us)][fromSq] & enemy;
+                if (!(occupancy & squareBB(fromSq + forward))) {
+                    reach |= squareBB(fromSq + forward);
+                    if ((fromSq >> 3) == startRank && !(occupancy & squareBB(fromSq + 2 * forward))) {
+                        reach |= squareBB(fromSq + 2 * forward);
+                    }
+                }
+                break;
+            }
+            case PieceType::KNIGHT: reach = attackTables.knight[fromSq]; break;
+            case PieceType::BISHOP: reach = bishopAttacks(fromSq, occupancy); break;
+            case PieceType::ROOK: reach = rookAttacks(fromSq, occupancy); break;
+            case PieceType::QUEEN: reach = queenAttacks(fromSq, occupancy); break;
+            case PieceType::KING:
+                if (move.kind() == Move::CASTLING) {
+                    if (isCheck(us)) return false;
+                    MoveList castles;
+                    generateCastlingMoves(castles, fromSq);
+                    return std::find(castles.begin(), castles.end(), move) != castles.end();
+                }
+                reach = attackTables.king[fromSq];
+                break;
+            default: return false;
+        }
+        if (!(reach & squareBB(toSq))) return false;
+        
+        //the king may not be left attacked; the moving piece is lifted off and the target taken
+        Bitboard after = (occupancy ^ squareBB(fromSq)) | squareBB(toSq);
+        int kingSq = (type == PieceType::KING) ? toSq : (pieces(PieceType::KING, us) ? lsb(pieces(PieceType::KING, us)) : -1);
+        return kingSq < 0 || !(attackersTo(kingSq, after) & enemy & ~squareBB(toSq));
+    }
+    
+    //material balance of the capture sequence on the target square, both sides always
+    //recapturing with their least valuable attacker and free to stop when behind
+    int staticExchange(const Move& move) const {
+        int fromSq = move.fromSq();
+        int toSq = move.toSq();
+        int gain[32];
+        int depth = 0;
+        Bitboard occupancy = occupied();
+        PieceType attacker = mailbox[fromSq];
+        if (mailbox[toSq] != PieceType::EMPTY) {
+            gain[0] = pieceValues[static_cast<int>(mailbox[toSq])];
+        } else if (move.kind() == Move::EN_PASSANT) {
+            //en passant: the captured pawn is not on the target square
+            gain[0] = pieceValues[static_cast<int>(PieceType::PAWN)];
+            occupancy ^= squareBB(toSq + ((currentPlayer == Color::WHITE) ? -8 : 8));
+        } else {
+            gain[0] = 0;
+        }
+        if (move.promotion() != PieceType::EMPTY) {
+            gain[0] += pieceValues[static_cast<int>(move.promotion())] - pieceValues[static_cast<int>(PieceType::PAWN)];
+            attacker = move.promotion();
+        }
+        
+        Bitboard diagonal = pieces(PieceType::BISHOP) | pieces(PieceType::QUEEN);
+        Bitboard straight = pieces(PieceType::ROOK) | pieces(PieceType::QUEEN);
+        occupancy ^= squareBB(fromSq);
+        Bitboard attackers = attackersTo(toSq, occupancy) & occupancy;
+        Color side = opposite(currentPlayer);
+        while (true) {
+            Bitboard own = attackers & pieces(side);
+            if (!own) break;
+            //least valuable attacker
+            int type = static_cast<int>(PieceType::PAWN);
+            while (!(own & pieces(static_cast<PieceType>(type)))) type++;
+            int sq = lsb(own & pieces(static_cast<PieceType>(type)));
+            
+            depth++;
+            gain[depth] = pieceValues[static_cast<int>(attacker)] - gain[depth - 1];
+            //stop once neither side can gain by going on; a king may only take last
+            if (std::max(-gain[depth - 1], gain[depth]) < 0 ||
+                (static_cast<PieceType>(type) == PieceType::KING && (attackers & pieces(opposite(side))))) {
+                depth--;
+                break;
+            }
+            if (depth == 31) break;
+            
+            //lifting the attacker may uncover a slider behind it
+            occupancy ^= squareBB(sq);
+            attackers |= (bishopAttacks(toSq, occupancy) & diagonal) | (rookAttacks(toSq, occupancy) & straight);
+            attackers &= occupancy;
+            attacker = static_cast<PieceType>(type);
+            side = opposite(side);
+        }
+        while (depth > 0) {
+            gain[depth - 1] = -std::max(-gain[depth - 1], gain[depth]);
+            depth--;
+        }
+        return gain[0];
+    }
+    
+    std::vector<Move> getAllLegalMoves() const {
+        MoveList moveList;
+        generateLegalMoves(moveList);
+        return std::vector<Move>(moveList.begin(), moveList.end());
+    }
+    
+    //number of leaf nodes of the legal move tree, the standard move generator check
+    uint64_t perft(int depth) const {
+        ChessBoard board = *this;
+        return board.perftFrom(depth);
+    }
+    
+    //perft split by root move, for narrowing down a generator bug against a reference engine
+    uint64_t divide(int depth) const {
+        MoveList moveList;
+        generateLegalMoves(moveList);
+        uint64_t total = 0;
+        for (const Move& move : moveList) {
+            ChessBoard next = *this;
+            next.playMove(move);
+            uint64_t nodes = next.perft(depth - 1);
+            std::cout << move.toString() << ": " << nodes << std::endl;
+            total += nodes;
+        }
+        std::cout << "Moves: " << moveList.size() << std::endl;
+        std::cout << "Nodes: " << total << std::endl;
+        return total;
+    }
+    
+    //everything the game-over and status queries need, computed with a single move generation
+    const GameStatus& getStatus() const {
+        if (!statusValid) {
+            MoveList moveList;
+            generateLegalMoves(moveList);
+            cachedStatus.legalMoveCount = moveList.size();
+            cachedStatus.inCheck = isCheck(currentPlayer);
+            if (moveList.empty()) {
+                cachedStatus.drawReason = cachedStatus.inCheck ? DrawReason::NONE : DrawReason::STALEMATE;
+            } else if (halfmoveClock >= 100) {
+                cachedStatus.drawReason = DrawReason::FIFTY_MOVE;
+            } else if (isInsufficientMaterial()) {
+                cachedStatus.drawReason = DrawReason::INSUFFICIENT_MATERIAL;
+            } else {
+                cachedStatus.drawReason = DrawReason::NONE;
+            }
+            statusValid = true;
+        }
+        return cachedStatus;
+    }
+    
+    bool hasLegalMoves() const {
+        return getStatus().legalMoveCount > 0;
+    }
+    
+    bool isCheckmate() const {
+        return getStatus().isCheckmate();
+    }
+    
+    bool isStalemate() const {
+        return getStatus().drawReason == DrawReason::STALEMATE;
+    }
+    
+    bool isDraw() const {
+        return getStatus().isDraw();
+    }
+    
+    //a hundred plies without a capture or pawn move; a mate on the last of them still counts
+    bool isFiftyMoveDraw() const {
+        return getStatus().drawReason == DrawReason::FIFTY_MOVE;
+    }
+    
+    //static score in centipawns from the side to move's point of view: material and piece-square
+    //bonuses blended from middlegame to endgame by the material left, all kept up to date by putPiece
+    int evaluate() const {
+        int phase = std::min(gamePhase, MAX_PHASE);
+        int score = (materialScore[0] * phase + materialScore[1] * (MAX_PHASE - phase)) / MAX_PHASE;
+        return (currentPlayer == Color::WHITE) ? score : -score;
+    }
+    
+    bool isInsufficientMaterial() const {
+        //any pawn, rook or queen is enough material to mate
+        if (pieces(PieceType::PAWN) | pieces(PieceType::ROOK) | pieces(PieceType::QUEEN)) {
+            return false;
+        }
+        int bishopsWhite = popCount(pieces(PieceType::BISHOP, Color::WHITE));
+        int bishopsBlack = popCount(pieces(PieceType::BISHOP, Color::BLACK));
+        int knightsWhite = popCount(pieces(PieceType::KNIGHT, Color::WHITE));
+        int knightsBlack = popCount(pieces(PieceType::KNIGHT, Color::BLACK));
+        int otherPieces = bishopsWhite + bishopsBlack + knightsWhite + knightsBlack;
+        
+        // King vs. King
+        if (otherPieces == 0) {
+            return true;
+        }
+        
+        // King and Bishop vs. King
+        if ((bishopsWhite == 1 && bishopsBlack == 0 && knightsWhite == 0 && knightsBlack == 0) ||
+            (bishopsWhite == 0 && bishopsBlack == 1 && knightsWhite == 0 && knightsBlack == 0)) {
+            return true;
+        }
+        
+        // King and Knight vs. King
+        if ((knightsWhite == 1 && knightsBlack == 0 && bishopsWhite == 0 && bishopsBlack == 0) ||
+            (knightsWhite == 0 && knightsBlack == 1 && bishopsWhite == 0 && bishopsBlack == 0)) {
+            return true;
+        }
+        
+        return false;
+    }
+    
+    //history holds the keys of the positions before this one, oldest first; a capture or pawn move
+    //makes every earlier position unreachable, so the scan stops after halfmoveClock plies
+    bool isThreefoldRepetition(const std::vector<uint64_t>& history) const {
+        int repetitions = 1;
+        int limit = std::min(halfmoveClock, static_cast<int>(history.size()));
+        for (int back = 2; back <= limit; back += 2) {
+            if (history[history.size() - back] == hashKey && ++repetitions >= 3) {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    std::string getGameState() const {
+        const GameStatus& status = getStatus();
+        if (status.isCheckmate()) {
+            return (currentPlayer == Color::WHITE) ? "Black wins by checkmate" : "White wins by checkmate";
+        } else if (status.drawReason == DrawReason::STALEMATE) {
+            return "Draw by stalemate";
+        } else if (status.drawReason == DrawReason::FIFTY_MOVE) {
+            return "Draw by fifty-move rule";
+        } else if (status.drawReason == DrawReason::INSUFFICIENT_MATERIAL) {
+            return "Draw by insufficient material";
+        } else if (status.inCheck) {
+            return (currentPlayer == Color::WHITE) ? "White is in check" : "Black is in check";
+        } else {
+            return (currentPlayer == Color::WHITE) ? "White to move" : "Black to move";
+        }
+    }
+    
+private:
+    //the piece a SAN letter stands for; EMPTY for anything else, pawns included
+    static PieceType sanPieceType(char c) {
+        switch (c) {
+            case 'N': return PieceType::KNIGHT;
+            case 'B': return PieceType::BISHOP;
+            case 'R': return PieceType::ROOK;
+            case 'Q': return PieceType::QUEEN;
+            case 'K': return PieceType::KING;
+            default: return PieceType::EMPTY;
+        }
+    }
+    
+    static void skipSpaces(std::string_view text, size_t& i) {
+        while (i < text.size() && text[i] == ' ') i++;
+    }
+    
+    static int parseNumber(std::string_view text, size_t& i) {
+        int value = 0;
+        while (i < text.size() && std::isdigit(static_cast<unsigned char>(text[i]))) {
+            value = value * 10 + (text[i++] - '0');
+        }
+        return value;
+    }
+    
+    //moves the pieces and updates castling and en passant state; the turn and clocks are left to playMove
+    void executeMove(const Move& move) {
+        Piece piece = getPiece(move.from());
+        Piece capturedPiece = getPiece(move.to());
+        hashKey ^= stateKey();
+        
+        //update castling flags
+        if (piece.type == PieceType::KING) {
+            if (piece.color == Color::WHITE) {
+                whiteKingMoved = true;
+            } else {
+                blackKingMoved = true;
+            }
+            
+            //handle castling move
+            if (abs(move.to().col - move.from().col) == 2) {
+                // King-side castling
+                if (move.to().col == 6) {
+                    // Move the rook
+                    Piece rook = getPiece(Position(move.from().row, 7));
+                    setPiece(Position(move.from().row, 5), rook);
+                    setPiece(Position(move.from().row, 7), Piece());
+                }
+                //queen-side castling
+                else if (move.to().col == 2) {
+                    // Move the rook
+                    Piece rook = getPiece(Position(move.from().row, 0));
+                    setPiece(Position(move.from().row, 3), rook);
+                    setPiece(Position(move.from().row, 0), Piece());
+                }
+            }
+        }
+        
+        //capturing a rook on its corner takes the opponent's castling on that side
+        if (capturedPiece.type == PieceType::ROOK) {
+            if (move.to() == Position(7, 0)) {
+                whiteQueenRookMoved = true;
+            } else if (move.to() == Position(7, 7)) {
+                whiteKingRookMoved = true;
+            } else if (move.to() == Position(0, 0)) {
+                blackQueenRookMoved = true;
+            } else if (move.to() == Position(0, 7)) {
+                blackKingRookMoved = true;
+            }
+        }
+        
+        //update rook moved flags
+        if (piece.type == PieceType::ROOK) {
+            if (piece.color == Color::WHITE) {
+                if (move.from() == Position(7, 0)) {
+                    whiteQueenRookMoved = true;
+                } else if (move.from() == Position(7, 7)) {
+                    whiteKingRookMoved = true;
+                }
+            } else {
+                if (move.from() == Position(0, 0)) {
+                    blackQueenRookMoved = true;
+                } else if (move.from() == Position(0, 7)) {
+                    blackKingRookMoved = true;
+                }
+            }
+        }
+        
+        // handle en passant capture
+        if (piece.type == PieceType::PAWN && move.to() == enPassantTarget) {
+            int captureRow = (piece.color == Color::WHITE) ? move.to().row + 1 : move.to().row - 1;
+            setPiece(Position(captureRow, move.to().col), Piece());
+        }
+        
+        //new en passant target if this is a double pawn move
+        enPassantTarget = Position(-1, -1); // Reset en passant target
+        if (piece.type == PieceType::PAWN && abs(move.to().row - move.from().row) == 2) {
+            int targetRow = (move.from().row + move.to().row) / 2;
+            enPassantTarget = Position(targetRow, move.from().col);
+        }
+        if (piece.type == PieceType::PAWN && (move.to().row == 0 || move.to().row == 7)) {
+            if (move.promotion() != PieceType::EMPTY) {
+                piece.type = move.promotion();
+            } else {
+                piece.type = PieceType::QUEEN; // Default promotion to queen
+            }
+        }
+        setPiece(move.to(), piece);
+        setPiece(move.from(), Piece());
+        hashKey ^= stateKey();
+        verifyHash();
+        verifyEval();
+    }
+    
+    //every child is a board copy (copy-make), which measures faster than doMove/undoMove on
+    //this compact board; CHESS_MAKE_UNMAKE switches to doing and undoing moves on one board
+    uint64_t perftFrom(int depth) {
+        if (depth <= 0) return 1;
+        MoveList moveList;
+        generateLegalMoves(moveList);
+        if (depth == 1) return moveList.size();
+        uint64_t nodes = 0;
+        for (const Move& move : moveList) {
+#ifdef CHESS_MAKE_UNMAKE
+            doMove(move);
+            nodes += perftFrom(depth - 1);
+            undoMove();
+#else
+            ChessBoard next = *this;
+            next.playMove(move);
+            nodes += next.perftFrom(depth - 1);
+#endif
+        }
+        return nodes;
+    }
+    
+    //target squares allowed by the generation stage, before any check or pin restriction
+    Bitboard typeMask(GenType type) const {
+        switch (type) {
+            case GenType::CAPTURES: return pieces(opposite(currentPlayer));
+            case GenType::QUIETS: return ~occupied();
+            default: return ~pieces(currentPlayer);
+        }
+    }
+    
+    void addMoves(MoveList& moveList, int fromSq, Bitboard targets) const {
+        while (targets) {
+            moveList.add(Move(fromSq, popLsb(targets)));
+        }
+    }
+    
+    void addPawnMoves(MoveList& moveList, int fromSq, int toSq) const {
+        //promotions for pawns reaching the last rank
+        if ((toSq >> 3) == 0 || (toSq >> 3) == 7) {
+            moveList.add(Move(fromSq, toSq, Move::PROMOTION, PieceType::QUEEN));
+            moveList.add(Move(fromSq, toSq, Move::PROMOTION, PieceType::ROOK));
+            moveList.add(Move(fromSq, toSq, Move::PROMOTION, PieceType::BISHOP));
+            moveList.add(Move(fromSq, toSq, Move::PROMOTION, PieceType::KNIGHT));
+        } else {
+            moveList.add(Move(fromSq, toSq));
+        }
+    }
+    
+    //non-king moves landing inside targetMask; pinned pieces stay on the line through their king
+    void generatePieceMoves(MoveList& moveList, Bitboard targetMask, Bitboard pinned, GenType type) const {
+        Color us = currentPlayer;
+        Bitboard occupancy = occupied();
+        Bitboard kings = pieces(PieceType::KING, us);
+        int kingSq = kings ? lsb(kings) : 0;
+        
+        generatePawnMoves(moveList, targetMask, pinned, kingSq, type);
+        targetMask &= typeMask(type);
+        
+        //a pinned knight can never stay on its pin line
+        Bitboard knights = pieces(PieceType::KNIGHT, us) & ~pinned;
+        while (knights) {
+            int fromSq = popLsb(knights);
+            addMoves(moveList, fromSq, attackTables.knight[fromSq] & targetMask);
+        }
+        
+        Bitboard queens = pieces(PieceType::QUEEN, us);
+        Bitboard diagonalSliders = pieces(PieceType::BISHOP, us) | queens;
+        while (diagonalSliders) {
+            int fromSq = popLsb(diagonalSliders);
+            Bitboard targets = bishopAttacks(fromSq, occupancy) & targetMask;
+            if (pinned & squareBB(fromSq)) targets &= attackTables.line[kingSq][fromSq];
+            addMoves(moveList, fromSq, targets);
+        }
+        Bitboard straightSliders = pieces(PieceType::ROOK, us) | queens;
+        while (straightSliders) {
+            int fromSq = popLsb(straightSliders);
+            Bitboard targets = rookAttacks(fromSq, occupancy) & targetMask;
+            if (pinned & squareBB(fromSq)) targets &= attackTables.line[kingSq][fromSq];
+            addMoves(moveList, fromSq, targets);
+        }
+    }
+    
+    //promotions count as captures, so pushes to the last rank belong to the capture stage
+    void generatePawnMoves(MoveList& moveList, Bitboard targetMask, Bitboard pinned, int kingSq, GenType type) const {
+        Color us = currentPlayer;
+        Bitboard enemy = pieces(opposite(us));
+        Bitboard occupancy = occupied();
+        int forward = (us == Color::WHITE) ? 8 : -8;
+        int startRank = (us == Color::WHITE) ? 1 : 6;
+        Bitboard lastRank = (us == Color::WHITE) ? 0xFF00000000000000ULL : 0xFFULL;
+        Bitboard pushMask = (type == GenType::CAPTURES) ? lastRank : (type == GenType::QUIETS) ? ~lastRank : ~0ULL;
+        if (type == GenType::QUIETS) enemy = 0;
+        int epSq = (enPassantTarget.isValid() && type != GenType::QUIETS) ? toSquare(enPassantTarget) : -1;
+        
+        Bitboard pawns = pieces(PieceType::PAWN, us);
+        while (pawns) {
+            int fromSq = popLsb(pawns);
+            Bitboard allowed = targetMask;
+            if (pinned & squareBB(fromSq)) allowed &= attackTables.line[kingSq][fromSq];
+            
+            //single and double pushes
+            int oneStep = fromSq + forward;
+            if (!(occupancy & squareBB(oneStep))) {
+                if (allowed & pushMask & squareBB(oneStep)) {
+                    addPawnMoves(moveList, fromSq, oneStep);
+                }
+                int twoStep = oneStep + forward;
+                if ((fromSq >> 3) == startRank && type != GenType::CAPTURES &&
+                    !(occupancy & squareBB(twoStep)) && (allowed & squareBB(twoStep))) {
+                    moveList.add(Move(fromSq, twoStep));
+                }
+            }
+            
+            //captures
+            Bitboard captures = attackTables.pawn[static_cast<int>(us)][fromSq] & enemy & allowed;
+            while (captures) {
+                addPawnMoves(moveList, fromSq, popLsb(captures));
+            }
+            
+            //en passant removes two pawns from one rank, so it is checked on the resulting occupancy
+            if (epSq >= 0 && (attackTables.pawn[static_cast<int>(us)][fromSq] & squareBB(epSq)) &&
+                isLegalEnPassant(fromSq, epSq)) {
+                moveList.add(Move(fromSq, epSq, Move::EN_PASSANT));
+            }
+        }
+    }
+    
+    bool isLegalEnPassant(int fromSq, int epSq) const {
+        Color us = currentPlayer;
+        Bitboard kings = pieces(PieceType::KING, us);
+        if (!kings) return true;
+        int capturedSq = epSq + ((us == Color::WHITE) ? -8 : 8);
+        Bitboard occupancy = (occupied() ^ squareBB(fromSq) ^ squareBB(capturedSq)) | squareBB(epSq);
+        return !(attackersTo(lsb(kings), occupancy) & pieces(opposite(us)) & ~squareBB(capturedSq));
+    }
+    
+    //castling for a king that is not in check; the king may not pass or land on an attacked square
+    void generateCastlingMoves(MoveList& moveList, int kingSq) const {
+        Color us = currentPlayer;
+        bool kingMoved = (us == Color::WHITE) ? whiteKingMoved : blackKingMoved;
+        int homeSq = (us == Color::WHITE) ? 4 : 60;
+        if (kingMoved || kingSq != homeSq) {
+            return;
+        }
+        Bitboard rooks = pieces(PieceType::ROOK, us);
+        Bitboard occupancy = occupied();
+        
+        //king-side: f and g empty and safe, rook still on h
+        bool kingRookMoved = (us == Color::WHITE) ? whiteKingRookMoved : blackKingRookMoved;
+        if (!kingRookMoved && (rooks & squareBB(kingSq + 3)) &&
+            !(occupancy & (squareBB(kingSq + 1) | squareBB(kingSq + 2))) &&
+            !isSquareAttacked(kingSq + 1, opposite(us)) && !isSquareAttacked(kingSq + 2, opposite(us))) {
+            moveList.add(Move(kingSq, kingSq + 2, Move::CASTLING));
+        }
+        
+        //queen-side: b, c and d empty, c and d safe, rook still on a
+        bool queenRookMoved = (us == Color::WHITE) ? whiteQueenRookMoved : blackQueenRookMoved;
+        if (!queenRookMoved && (rooks & squareBB(kingSq - 4)) &&
+            !(occupancy & (squareBB(kingSq - 1) | squareBB(kingSq - 2) | squareBB(kingSq - 3))) &&
+            !isSquareAttacked(kingSq - 1, opposite(us)) && !isSquareAttacked(kingSq - 2, opposite(us))) {
+            moveList.add(Move(kingSq, kingSq - 2, Move::CASTLING));
+        }
+    }
+};
+
+//read-only view of a whole file. Regular files are memory-mapped; pipes and platforms without
+//mmap are read in 1 MB chunks into one buffer. The view stays valid until the object dies.
+class MappedFile {
+public:
+    MappedFile() : mapped(nullptr), length(0) {}
+    
+    ~MappedFile() {
+        close();
+    }
+    
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    bool open(const std::string& path) {
+        close();
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+            length = static_cast<size_t>(info.st_size);
+            void* memory = (length > 0) ? mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+            ::close(fd);
+            if (memory == MAP_FAILED) {
+                length = 0;
+                return false;
+            }
+            if (memory) {
+                madvise(memory, length, MADV_SEQUENTIAL);
+            }
+            mapped = memory;
+            return true;
+        }
+        ::close(fd);
+#endif
+        return readChunks(path);
+    }
+    
+    void close() {
+#if defined(__unix__) || defined(__APPLE__)
+        if (mapped) {
+            munmap(mapped, length);
+        }
+#endif
+        mapped = nullptr;
+        length = 0;
+        buffer.clear();
+    }
+    
+    std::string_view view() const {
+        if (mapped) {
+            return std::string_view(static_cast<const char*>(mapped), length);
+        }
+        return std::string_view(buffer.data(), buffer.size());
+    }
+    
+private:
+    bool readChunks(const std::string& path) {
+        static const size_t CHUNK = 1 << 20;
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return false;
+        while (in) {
+            size_t used = buffer.size();
+            buffer.resize(used + CHUNK);
+            in.read(buffer.data() + used, CHUNK);
+            buffer.resize(used + static_cast<size_t>(in.gcount()));
+        }
+        return !in.bad();
+    }
+    
+    void* mapped;
+    size_t length;
+    std::vector<char> buffer;
+};
+
+//Polyglot opening book (.bin): 16-byte big-endian entries of key, move, weight and learn data,
+//sorted by key. The file is mapped and binary-searched in place, so a probe allocates nothing.
+class PolyglotBook {
+public:
+    static const size_t ENTRY_SIZE = 16;
+    
+    PolyglotBook() : entries(nullptr), entryCount(0) {}
+    
+    bool open(const std::string& path) {
+        close();
+        if (!file.open(path)) return false;
+        if (file.view().size() % ENTRY_SIZE != 0) {
+            close();
+            return false;
+        }
+        entries = reinterpret_cast<const uint8_t*>(file.view().data());
+        entryCount = file.view().size() / ENTRY_SIZE;
+        return true;
+    }
+    
+    void close() {
+        file.close();
+        entries = nullptr;
+        entryCount = 0;
+    }
+    
+    bool isOpen() const {
+        return entryCount > 0;
+    }
+    
+    size_t size() const {
+        return entryCount;
+    }
+    
+    //a book move for the position, chosen with probability proportional to its weight: random may
+    //be any 64-bit value. False when the book has no playable move here.
+    bool pickMove(const ChessBoard& board, uint64_t random, Move& move) const {
+        Move moves[MoveList::CAPACITY];
+        int weights[MoveList::CAPACITY];
+        int count = probe(board, moves, weights, MoveList::CAPACITY);
+        uint64_t total = 0;
+        for (int i = 0; i < count; i++) total += static_cast<uint64_t>(weights[i]);
+        if (total == 0) return false;
+        uint64_t target = random % total;
+        for (int i = 0; i < count; i++) {
+            if (target < static_cast<uint64_t>(weights[i])) {
+                move = moves[i];
+                return true;
+            }
+            target -= static_cast<uint64_t>(weights[i]);
+        }
+        return false;
+    }
+    
+    //the position's legal book moves and weights in book order (heaviest first in a sorted book);
+    //returns how many were written, at most capacity
+    int probe(const ChessBoard& board, Move* moves, int* weights, int capacity) const {
+        uint64_t key = board.polyglotKey();
+        int count = 0;
+        for (size_t i = lowerBound(key); i < entryCount && entryKey(i) == key && count < capacity; i++) {
+            if (board.fromPolyglotMove(entryMove(i), moves[count])) {
+                weights[count++] = entryWeight(i);
+            }
+        }
+        return count;
+    }
+    
+private:
+    MappedFile file;
+    const uint8_t* entries;
+    size_t entryCount;
+    
+    static uint64_t readBigEndian(const uint8_t* bytes, int length) {
+        uint64_t value = 0;
+        for (int i = 0; i < length; i++) value = (value << 8) | bytes[i];
+        return value;
+    }
+    
+    uint64_t entryKey(size_t index) const {
+        return readBigEndian(entries + index * ENTRY_SIZE, 8);
+    }
+    
+    uint16_t entryMove(size_t index) const {
+        return static_cast<uint16_t>(readBigEndian(entries + index * ENTRY_SIZE + 8, 2));
+    }
+    
+    uint16_t entryWeight(size_t index) const {
+        return static_cast<uint16_t>(readBigEndian(entries + index * ENTRY_SIZE + 10, 2));
+    }
+    
+    size_t lowerBound(uint64_t key) const {
+        size_t low = 0;
+        size_t high = entryCount;
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+            if (entryKey(middle) < key) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return low;
+    }
+};
+
+//a move played for the length of a scope, as perft does it: the child is a copy of the parent
+//board, or with CHESS_MAKE_UNMAKE the parent itself, which the destructor restores with undoMove
+class MoveScope {
+public:
+#ifdef CHESS_MAKE_UNMAKE
+    MoveScope(ChessBoard& parent, const Move& move) : position(parent) {
+        position.doMove(move);
+    }
+    
+    ~MoveScope() {
+        position.undoMove();
+    }
+#else
+    MoveScope(ChessBoard& parent, const Move& move) : position(parent) {
+        position.playMove(move);
+    }
+#endif
+    
+    MoveScope(const MoveScope&) = delete;
+    MoveScope& operator=(const MoveScope&) = delete;
+    
+    ChessBoard& board() {
+        return position;
+    }
+    
+private:
+#ifdef CHESS_MAKE_UNMAKE
+    ChessBoard& position;
+#else
+    ChessBoard position;
+#endif
+};
+
+//game controller class
+class ChessGame {
+private:
+    ChessBoard board;
+    std::vector<Move> moveHistory;
+    std::vector<uint64_t> positionHistory; //hash of the position before each move in moveHistory
+    std::string startFEN;                  //empty when the game began from the initial position
+    
+public:
+    ChessGame() : board() {}
+    
+    void start() {
+        board.resetBoard();
+        moveHistory.clear();
+        positionHistory.clear();
+        startFEN.clear();
+    }
+    
+    //start from an arbitrary position instead of the initial one
+    bool loadFEN(const std::string& fen) {
+        if (!board.fromFEN(fen)) {
+            return false;
+        }
+        moveHistory.clear();
+        positionHistory.clear();
+        startFEN = board.toFEN();
+        return true;
+    }
+    
+    const std::string& getStartFEN() const {
+        return startFEN;
+    }
+    
+    std::string getFEN() const {
+        return board.toFEN();
+    }
+    
+    void printBoard() const {
+        board.displayBoard();
+        std::cout << getResult() << std::endl;
+    }
+    
+    bool makeMove(const std::string& moveStr) {
+        if (moveStr.length() < 4) {
+            std::cout << "Invalid move format. Please use format like 'e2e4' or 'e7e8q' for promotion." << std::endl;
+            return false;
+        }
+        
+        Position from = Position::fromAlgebraic(moveStr.substr(0, 2));
+        Position to = Position::fromAlgebraic(moveStr.substr(2, 2));
+        
+        PieceType promotion = PieceType::EMPTY;
+        if (moveStr.length() >= 5) {
+            char promotionChar = std::tolower(moveStr[4]);
+            switch (promotionChar) {
+                case 'q': promotion = PieceType::QUEEN; break;
+                case 'r': promotion = PieceType::ROOK; break;
+                case 'b': promotion = PieceType::BISHOP; break;
+                case 'n': promotion = PieceType::KNIGHT; break;
+                default: 
+                    std::cout << "Invalid promotion piece. Use q, r, b, or n." << std::endl;
+                    return false;
+            }
+        }
+        
+        Move move;
+        if (from.isValid() && to.isValid() && board.resolveMove(Move(from, to, promotion), move) && makeMove(move)) {
+            return true;
+        } else {
+            std::cout << "Invalid move." << std::endl;
+            return false;
+        }
+    }
+    
+    bool makeMove(const Move& move) {
+        uint64_t previousHash = board.getHash();
+        if (!board.makeMove(move)) {
+            return false;
+        }
+        moveHistory.push_back(move);
+        positionHistory.push_back(previousHash);
+        return true;
+    }
+    
+    //for moves already known to be legal, e.g. from generateLegalMoves or parseSAN, without the
+    //validation makeMove does
+    void playLegalMove(const Move& move) {
+        positionHistory.push_back(board.getHash());
+        moveHistory.push_back(move);
+        board.playMove(move);
+    }
+    
+    //play a weighted random book move if the book knows the position; random may be any 64-bit value
+    bool playBookMove(const PolyglotBook& book, uint64_t random) {
+        Move move;
+        if (!book.pickMove(board, random, move)) {
+            return false;
+        }
+        playLegalMove(move);
+        return true;
+    }
+    
+    const ChessBoard& getBoard() const {
+        return board;
+    }
+    
+    const std::vector<uint64_t>& getPositionHistory() const {
+        return positionHistory;
+    }
+    
+    bool isDrawByRepetition() const {
+        return board.isThreefoldRepetition(positionHistory);
+    }
+    
+    bool isGameOver() const {
+        return board.getStatus().isGameOver() || isDrawByRepetition();
+    }
+    
+    std::string getResult() const {
+        //a repeated position was followed by a move before, so it can be neither mate nor stalemate
+        if (isDrawByRepetition()) {
+            return "Draw by threefold repetition";
+        }
+        return board.getGameState();
+    }
+    
+    //UNKNOWN while the game is still going
+    GameResult getOutcome() const {
+        if (board.isCheckmate()) {
+            return (board.getCurrentPlayer() == Color::WHITE) ? GameResult::BLACK_WINS : GameResult::WHITE_WINS;
+        }
+        return isGameOver() ? GameResult::DRAW : GameResult::UNKNOWN;
+    }
+    
+    Color getCurrentPlayer() const {
+        return board.getCurrentPlayer();
+    }
+    
+    MoveList getLegalMoves() const {
+        MoveList moves;
+        board.generateLegalMoves(moves);
+        return moves;
+    }
+    
+    void printLegalMoves() const {
+        MoveList moves = getLegalMoves();
+        std::cout << "Legal moves: ";
+        for (const auto& move : moves) {
+            std::cout << move.toString() << " ";
+        }
+        std::cout << std::endl;
+    }
+    
+    const std::vector<Move>& getMoveHistory() const {
+        return moveHistory;
+    }
+};
+
+//fixed set of worker threads; each owns a task deque and steals from the others when it runs dry
+class ThreadPool {
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+    
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex stateMutex;
+    std::condition_variable workAvailable;
+    std::condition_variable allDone;
+    int queuedTasks;
+    int unfinishedTasks;
+    unsigned nextQueue;
+    bool stopping;
+    
+public:
+    explicit ThreadPool(int threadCount) : queuedTasks(0), unfinishedTasks(0), nextQueue(0), stopping(false) {
+        if (threadCount < 1) threadCount = 1;
+        for (int i = 0; i < threadCount; i++) {
+            queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+        }
+        for (int i = 0; i < threadCount; i++) {
+            workers.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+    
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            stopping = true;
+        }
+        workAvailable.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+    
+    int size() const {
+        return static_cast<int>(workers.size());
+    }
+    
+    //queue a task, spreading submissions round-robin over the workers' deques
+    void submit(std::function<void()> task) {
+        unsigned target;
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            target = nextQueue++ % queues.size();
+            queuedTasks++;
+            unfinishedTasks++;
+        }
+        {
+            std::lock_guard<std::mutex> lock(queues[target]->mutex);
+            queues[target]->tasks.push_back(std::move(task));
+        }
+        workAvailable.notify_one();
+    }
+    
+    //block until every submitted task has finished
+    void wait() {
+        std::unique_lock<std::mutex> lock(stateMutex);
+        allDone.wait(lock, [this] { return unfinishedTasks == 0; });
+    }
+    
+private:
+    //own tasks come off the back (most recently queued), stolen ones off the front
+    bool takeTask(int self, std::function<void()>& task) {
+        int count = static_cast<int>(queues.size());
+        for (int i = 0; i < count; i++) {
+            WorkerQueue& queue = *queues[(self + i) % count];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty()) continue;
+            if (i == 0) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            } else {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+            return true;
+        }
+        return false;
+    }
+    
+    void workerLoop(int self) {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(stateMutex);
+                workAvailable.wait(lock, [this] { return stopping || queuedTasks > 0; });
+                if (queuedTasks == 0) return; //stopping with nothing left to do
+                queuedTasks--;
+            }
+            //a task was reserved above, so some deque holds one until we find it
+            while (!takeTask(self, task)) {
+                std::this_thread::yield();
+            }
+            task();
+            {
+                std::lock_guard<std::mutex> lock(stateMutex);
+                unfinishedTasks--;
+                if (unfinishedTasks == 0) allDone.notify_all();
+            }
+        }
+    }
+};
+
+//perft with the first splitDepth plies expanded into independent tasks on a thread pool;
+//every task works on its own board copy and results are summed in generation order
+uint64_t parallelPerft(const ChessBoard& board, int depth, ThreadPool& pool, int splitDepth = 2) {
+    if (depth <= splitDepth) {
+        return board.perft(depth);
+    }
+    std::vector<ChessBoard> roots(1, board);
+    for (int ply = 0; ply < splitDepth; ply++) {
+        std::vector<ChessBoard> children;
+        for (const ChessBoard& parent : roots) {
+            MoveList moveList;
+            parent.generateLegalMoves(moveList);
+            for (const Move& move : moveList) {
+                children.push_back(parent);
+                children.back().playMove(move);
+            }
+        }
+        roots.swap(children);
+    }
+    
+    std::vector<uint64_t> results(roots.size(), 0);
+    for (size_t i = 0; i < roots.size(); i++) {
+        pool.submit([&roots, &results, i, depth, splitDepth] {
+            ChessBoard local = roots[i];
+            results[i] = local.perft(depth - splitDepth);
+        });
+    }
+    pool.wait();
+    
+    uint64_t nodes = 0;
+    for (uint64_t count : results) {
+        nodes += count;
+    }
+    return nodes;
+}
+
+//run the same parallel perft at 1, 2, 4 ... maxThreads workers and report the speedup
+bool runParallelPerftScaling(const ChessBoard& board, int depth, int maxThreads) {
+    double baseSeconds = 0;
+    uint64_t baseNodes = 0;
+    bool consistent = true;
+    for (int threads = 1; threads <= maxThreads; threads = (threads * 2 > maxThreads && threads < maxThreads) ? maxThreads : threads * 2) {
+        ThreadPool pool(threads);
+        auto start = std::chrono::steady_clock::now();
+        uint64_t nodes = parallelPerft(board, depth, pool);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (threads == 1) {
+            baseSeconds = seconds;
+            baseNodes = nodes;
+        }
+        consistent = consistent && nodes == baseNodes;
+        std::cout << threads << " thread(s): " << nodes << " nodes in " << seconds << " s, "
+                  << static_cast<uint64_t>(nodes / (seconds > 0 ? seconds : 1e-9)) << " nps, speedup "
+                  << (seconds > 0 ? baseSeconds / seconds : 0) << "x" << std::endl;
+    }
+    if (!consistent) {
+        std::cout << "Node counts differ between thread counts" << std::endl;
+    }
+    return consistent;
+}
+
+//reference positions with published perft counts, indexed by depth - 1
+struct PerftPosition {
+    const char* name;
+    const char* fen;
+    uint64_t nodes[6];
+};
+
+static const PerftPosition perftPositions[] = {
+    { "start", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+      { 20, 400, 8902, 197281, 4865609, 119060324 } },
+    { "kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+      { 48, 2039, 97862, 4085603, 193690690, 0 } },
+    { "endgame-ep", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+      { 14, 191, 2812, 43238, 674624, 11030083 } },
+    { "promotions", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+      { 6, 264, 9467, 422333, 15833292, 706045033 } },
+    { "promotions-mirrored", "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1",
+      { 6, 264, 9467, 422333, 15833292, 706045033 } },
+    { "castling-checks", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+      { 44, 1486, 62379, 2103487, 89941194, 0 } },
+};
+
+//run every reference position up to maxDepth; returns false if any count is off
+bool runPerftSuite(int maxDepth) {
+    std::cout << "Slider tables built in " << sliderTables.initMillis << " ms" << std::endl;
+    bool allPassed = true;
+    uint64_t totalNodes = 0;
+    double totalSeconds = 0;
+    for (const PerftPosition& position : perftPositions) {
+        ChessBoard board;
+        board.fromFEN(position.fen);
+        for (int depth = 1; depth <= maxDepth && depth <= 6 && position.nodes[depth - 1]; depth++) {
+            auto start = std::chrono::steady_clock::now();
+            uint64_t nodes = board.perft(depth);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            bool passed = nodes == position.nodes[depth - 1];
+            allPassed = allPassed && passed;
+            totalNodes += nodes;
+            totalSeconds += seconds;
+            std::cout << (passed ? "ok   " : "FAIL ") << position.name << " depth " << depth
+                      << ": " << nodes << " nodes";
+            if (!passed) {
+                std::cout << " (expected " << position.nodes[depth - 1] << ")";
+            }
+            std::cout << ", " << static_cast<uint64_t>(nodes / (seconds > 0 ? seconds : 1e-9)) << " nps" << std::endl;
+        }
+    }
+    std::cout << "Total: " << totalNodes << " nodes in " << totalSeconds << " s, "
+              << static_cast<uint64_t>(totalNodes / (totalSeconds > 0 ? totalSeconds : 1e-9)) << " nps" << std::endl;
+    std::cout << (allPassed ? "All perft counts match" : "Perft mismatch") << std::endl;
+    return allPassed;
+}
+
+//the test positions published with the Polyglot book format; a wrong Random64 value or key rule
+//would make every book lookup miss, so the perft suite checks these as well
+struct PolyglotKeyPosition {
+    const char* fen;
+    uint64_t key;
+};
+
+static const PolyglotKeyPosition polyglotKeyPositions[] = {
+    { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 0x463b96181691fc9cULL },
+    { "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1", 0x823c9b50fd114196ULL },
+    { "rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2", 0x0756b94461c50fb0ULL },
+    { "rnbqkbnr/ppp1pppp/8/3pP3/8/8/PPPP1PPP/RNBQKBNR b KQkq - 0 2", 0x662fafb965db29d4ULL },
+    { "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3", 0x22a48b5a8e47ff78ULL },
+    { "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR b kq - 0 3", 0x652a607ca3f242c1ULL },
+    { "rnbq1bnr/ppp1pkpp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR w - - 0 4", 0x00fdd303c946bdd9ULL },
+    { "rnbqkbnr/p1pppppp/8/8/PpP4P/8/1P1PPPP1/RNBQKBNR b KQkq c3 0 3", 0x3c8123ea7b067637ULL },
+    { "rnbqkbnr/p1pppppp/8/8/P6P/R1p5/1P1PPPP1/1NBQKBNR b Kkq - 0 4", 0x5c3f9b829b279560ULL },
+};
+
+//returns false if any reference position hashes to a different Polyglot key
+bool checkPolyglotKeys() {
+    bool allPassed = true;
+    for (const PolyglotKeyPosition& position : polyglotKeyPositions) {
+        ChessBoard board;
+        board.fromFEN(position.fen);
+        uint64_t key = board.polyglotKey();
+        if (key != position.key) {
+            std::cout << "FAIL polyglot key " << std::hex << key << " (expected " << position.key << std::dec
+                      << ") for " << position.fen << std::endl;
+            allPassed = false;
+        }
+    }
+    std::cout << (allPassed ? "All Polyglot keys match" : "Polyglot key mismatch") << std::endl;
+    return allPassed;
+}
+
+//fixed-size hash table of search results shared by every search thread. Clusters of four
+//16-byte entries fill one cache line. Entries are read and written without locks: the key
+//is stored XORed with the data word, so a torn write simply fails verification on probe.
+class TranspositionTable {
+public:
+    enum Bound : uint8_t {
+        BOUND_NONE = 0, BOUND_UPPER = 1, BOUND_LOWER = 2, BOUND_EXACT = 3
+    };
+    
+    struct ProbeResult {
+        uint16_t move;
+        int score;
+        int depth;
+        Bound bound;
+    };
+    
+    explicit TranspositionTable(size_t megabytes = 16, bool hugePages = true)
+        : clusters(nullptr), clusterCount(0), useHugePages(hugePages), generation(0) {
+        resize(megabytes);
+    }
+    
+    ~TranspositionTable() {
+        release();
+    }
+    
+    TranspositionTable(const TranspositionTable&) = delete;
+    TranspositionTable& operator=(const TranspositionTable&) = delete;
+    
+    //the cluster count is rounded down to a power of two so the index is a mask of the key
+    void resize(size_t megabytes) {
+        release();
+        size_t count = 1;
+        while (count * 2 * sizeof(Cluster) <= std::max<size_t>(megabytes, 1) * 1024 * 1024) {
+            count *= 2;
+        }
+        size_t bytes = count * sizeof(Cluster);
+        //2 MB alignment lets the kernel back the table with huge pages
+        size_t alignment = (bytes >= (2u << 20)) ? (2u << 20) : alignof(Cluster);
+#ifdef _MSC_VER
+        void* memory = _aligned_malloc(bytes, alignment);
+#else
+        void* memory = std::aligned_alloc(alignment, bytes);
+#endif
+        if (!memory) {
+            throw std::bad_alloc();
+        }
+#ifdef __linux__
+        if (useHugePages && alignment > alignof(Cluster)) {
+            madvise(memory, bytes, MADV_HUGEPAGE);
+        }
+#endif
+        clusters = static_cast<Cluster*>(memory);
+        clusterCount = count;
+        for (size_t i = 0; i < clusterCount; i++) {
+            new (&clusters[i]) Cluster();
+        }
+        clear();
+    }
+    
+    void clear() {
+        for (size_t i = 0; i < clusterCount; i++) {
+            for (Entry& entry : clusters[i].entries) {
+                entry.keyXorData.store(0, std::memory_order_relaxed);
+                entry.data.store(0, std::memory_order_relaxed);
+            }
+        }
+        generation = 0;
+    }
+    
+    size_t sizeMegabytes() const {
+        return clusterCount * sizeof(Cluster) / (1024 * 1024);
+    }
+    
+    //entries from earlier searches age out first; call once per search
+    void newSearch() {
+        generation = (generation + 1) & 63;
+    }
+    
+    bool probe(uint64_t key, ProbeResult& result) const {
+        const Cluster& cluster = clusters[key & (clusterCount - 1)];
+        for (const Entry& entry : cluster.entries) {
+            uint64_t data = entry.data.load(std::memory_order_relaxed);
+            if ((entry.keyXorData.load(std::memory_order_relaxed) ^ data) == key && data != 0) {
+                result.move = static_cast<uint16_t>(data);
+                result.score = static_cast<int16_t>(data >> 16);
+                result.depth = static_cast<uint8_t>(data >> 32);
+                result.bound = static_cast<Bound>((data >> 40) & 3);
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    //same position: overwrite unless that throws away a clearly deeper result of this search.
+    //Otherwise evict the entry with the lowest depth, counting each search of age as 8 plies.
+    void store(uint64_t key, uint16_t move, int score, int depth, Bound bound) {
+        Cluster& cluster = clusters[key & (clusterCount - 1)];
+        Entry* target = nullptr;
+        int lowestWorth = INT_MAX;
+        for (Entry& entry : cluster.entries) {
+            uint64_t data = entry.data.load(std::memory_order_relaxed);
+            int entryDepth = static_cast<uint8_t>(data >> 32);
+            int entryAge = (generation - static_cast<int>(data >> 42)) & 63;
+            if ((entry.keyXorData.load(std::memory_order_relaxed) ^ data) == key && data != 0) {
+                if (bound != BOUND_EXACT && entryAge == 0 && depth + 2 < entryDepth) {
+                    return;
+                }
+                if (move == 0) {
+                    move = static_cast<uint16_t>(data);
+                }
+                target = &entry;
+                break;
+            }
+            int worth = (data == 0) ? INT_MIN : entryDepth - 8 * entryAge;
+            if (worth < lowestWorth) {
+                lowestWorth = worth;
+                target = &entry;
+            }
+        }
+        uint64_t data = static_cast<uint64_t>(move) |
+                        (static_cast<uint64_t>(static_cast<uint16_t>(score)) << 16) |
+                        (static_cast<uint64_t>(std::min(std::max(depth, 0), 255)) << 32) |
+                        (static_cast<uint64_t>(bound) << 40) |
+                        (static_cast<uint64_t>(generation) << 42);
+        target->keyXorData.store(key ^ data, std::memory_order_relaxed);
+        target->data.store(data, std::memory_order_relaxed);
+    }
+    
+    //permille of sampled entries written during the current search
+    int hashfull() const {
+        int used = 0;
+        size_t sample = std::min<size_t>(250, clusterCount);
+        for (size_t i = 0; i < sample; i++) {
+            for (const Entry& entry : clusters[i].entries) {
+                uint64_t data = entry.data.load(std::memory_order_relaxed);
+                used += (data != 0 && static_cast<int>(data >> 42) == generation);
+            }
+        }
+        return static_cast<int>(used * 1000 / (sample * 4));
+    }
+    
+private:
+    struct Entry {
+        std::atomic<uint64_t> keyXorData;
+        std::atomic<uint64_t> data; //move 0-15, score 16-31, depth 32-39, bound 40-41, generation 42-47
+    };
+    
+    struct alignas(64) Cluster {
+        Entry entries[4];
+    };
+    
+    Cluster* clusters;
+    size_t clusterCount;
+    bool useHugePages;
+    int generation;
+    
+    void release() {
+        if (!clusters) return;
+#ifdef _MSC_VER
+        _aligned_free(clusters);
+#else
+        std::free(clusters);
+#endif
+        clusters = nullptr;
+        clusterCount = 0;
+    }
+};
+
+//limits for one search; zero leaves that dimension unbounded
+struct SearchLimits {
+    int depth;
+    int64_t movetimeMs;
+    uint64_t nodes;
+    bool infinite;   //analysis: run until stopped, even past a forced mate
+    
+    SearchLimits() : depth(0), movetimeMs(0), nodes(0), infinite(false) {}
+};
+
+struct SearchResult {
+    Move bestMove;
+    bool hasMove;
+    int score;       //centipawns for the side to move; mates are MATE_SCORE minus the distance in plies
+    int depth;       //deepest fully completed iteration
+    uint64_t nodes;
+    double seconds;
+    std::vector<Move> pv;
+    
+    SearchResult() : hasMove(false), score(0), depth(0), nodes(0), seconds(0) {}
+    
+    uint64_t nodesPerSecond() const {
+        return static_cast<uint64_t>(nodes / (seconds > 0 ? seconds : 1e-9));
+    }
+};
+
+//hands out the legal moves of one node best guess first: the hash move, captures that do not
+//lose material by MVV-LVA, the killers, quiets by history score and last the losing captures.
+//Quiets are generated only when no capture has cut the node off.
+class MovePicker {
+public:
+    //capturesOnly stops after the winning and equal captures, for the quiescence search
+    MovePicker(const ChessBoard& position, const Move& preferred, const Move* killerMoves,
+               const int (*historyTable)[64], bool capturesOnly)
+        : board(position), hashMove(preferred), history(historyTable), quiescence(capturesOnly),
+          stage(HASH_MOVE), current(0), killerIndex(0), badIndex(0) {
+        killers[0] = killerMoves ? killerMoves[0] : Move();
+        killers[1] = killerMoves ? killerMoves[1] : Move();
+        if (!board.isLegalMove(hashMove) || (quiescence && !board.isCapture(hashMove))) {
+            hashMove = Move();
+            stage = GENERATE_CAPTURES;
+        }
+    }
+    
+    bool next(Move& move) {
+        switch (stage) {
+            case HASH_MOVE:
+                stage = GENERATE_CAPTURES;
+                move = hashMove;
+                return true;
+                
+            case GENERATE_CAPTURES:
+                board.generateLegalMoves(moves, GenType::CAPTURES);
+                for (int i = 0; i < moves.size(); i++) {
+                    scores[i] = captureScore(moves[i]);
+                }
+                current = 0;
+                stage = GOOD_CAPTURES;
+                //fall through
+            case GOOD_CAPTURES:
+                while (current < moves.size()) {
+                    const Move& candidate = pickBest();
+                    if (candidate == hashMove) continue;
+                    if (board.staticExchange(candidate) < 0) {
+                        if (!quiescence) badCaptures.add(candidate);
+                        continue;
+                    }
+                    move = candidate;
+                    return true;
+                }
+                if (quiescence) {
+                    stage = DONE;
+                    return false;
+                }
+                stage = KILLERS;
+                //fall through
+            case KILLERS:
+                while (killerIndex < 2) {
+                    const Move& killer = killers[killerIndex++];
+                    if (killer != hashMove && !board.isCapture(killer) && board.isLegalMove(killer)) {
+                        move = killer;
+                        return true;
+                    }
+                }
+                stage = GENERATE_QUIETS;
+                //fall through
+            case GENERATE_QUIETS:
+                moves.clear();
+                board.generateLegalMoves(moves, GenType::QUIETS);
+                for (int i = 0; i < moves.size(); i++) {
+                    scores[i] = history ? history[moves[i].fromSq()][moves[i].toSq()] : 0;
+                }
+                current = 0;
+                stage = QUIETS;
+                //fall through
+            case QUIETS:
+                while (current < moves.size()) {
+                    const Move& candidate = pickBest();
+                    if (candidate == hashMove || candidate == killers[0] || candidate == killers[1]) continue;
+                    move = candidate;
+                    return true;
+                }
+                stage = BAD_CAPTURES;
+                //fall through
+            case BAD_CAPTURES:
+                if (badIndex < badCaptures.size()) {
+                    move = badCaptures[badIndex++];
+                    return true;
+                }
+                stage = DONE;
+                //fall through
+            default:
+                return false;
+        }
+    }
+    
+private:
+    enum Stage : uint8_t {
+        HASH_MOVE, GENERATE_CAPTURES, GOOD_CAPTURES, KILLERS, GENERATE_QUIETS, QUIETS, BAD_CAPTURES, DONE
+    };
+    
+    const ChessBoard& board;
+    Move hashMove;
+    Move killers[2];
+    const int (*history)[64];
+    bool quiescence;
+    Stage stage;
+    MoveList moves;
+    int scores[MoveList::CAPACITY];
+    int current;
+    int killerIndex;
+    MoveList badCaptures;
+    int badIndex;
+    
+    //most valuable victim first, least valuable attacker breaking ties
+    int captureScore(const Move& move) const {
+        PieceType victim = board.getPiece(move.to()).type;
+        if (victim == PieceType::EMPTY && move.promotion() == PieceType::EMPTY) victim = PieceType::PAWN;
+        int score = pieceValues[static_cast<int>(victim)] * 8 - pieceValues[static_cast<int>(board.getPiece(move.from()).type)] / 100;
+        if (move.promotion() != PieceType::EMPTY) score += pieceValues[static_cast<int>(move.promotion())] * 8;
+        return score;
+    }
+    
+    //selection sort one step at a time: a cutoff leaves the rest of the list unsorted
+    const Move& pickBest() {
+        int best = current;
+        for (int i = current + 1; i < moves.size(); i++) {
+            if (scores[i] > scores[best]) best = i;
+        }
+        std::swap(moves.moves[best], moves.moves[current]);
+        std::swap(scores[best], scores[current]);
+        return moves.moves[current++];
+    }
+};
+
+//negamax alpha-beta with iterative deepening and a quiescence search, on board copies (copy-make)
+class SearchEngine {
+public:
+    static const int MAX_PLY = 128;
+    static const int MATE_SCORE = 32000;
+    static const int INFINITE_SCORE = 32001;
+    static const int MAX_HISTORY = 16384;
+    
+    //called after every completed iteration, e.g. to print progress
+    std::function<void(const SearchResult&)> onIteration;
+    
+    //with no table given the engine allocates a private one
+    SearchEngine() : ownedTable(new TranspositionTable()), tt(ownedTable.get()),
+                     threadIndex(-1), sharedStop(nullptr), stopRequested(false), stopped(false), nodes(0),
+                     pvTable(MAX_PLY * MAX_PLY), pvLength(MAX_PLY, 0) {
+        clearHistory();
+    }
+    
+    explicit SearchEngine(TranspositionTable& sharedTable) : tt(&sharedTable),
+                     threadIndex(-1), sharedStop(nullptr), stopRequested(false), stopped(false), nodes(0),
+                     pvTable(MAX_PLY * MAX_PLY), pvLength(MAX_PLY, 0) {
+        clearHistory();
+    }
+    
+    TranspositionTable& getTable() {
+        return *tt;
+    }
+    
+    //forget the move ordering statistics, e.g. before an unrelated position
+    void clearHistory() {
+        for (int side = 0; side < 3; side++) {
+            for (int from = 0; from < 64; from++) {
+                for (int to = 0; to < 64; to++) {
+                    history[side][from][to] = 0;
+                }
+            }
+        }
+    }
+    
+    //joins the engine to a parallel search: the owner ages the table and raises abortFlag to end it.
+    //Odd-numbered threads start one ply deeper so the threads spread over different depths.
+    void setThread(int index, const std::atomic<bool>* abortFlag) {
+        threadIndex = index;
+        sharedStop = abortFlag;
+    }
+    
+    //gameHistory holds the keys of the game positions before root, so repetitions are seen as draws
+    SearchResult search(const ChessBoard& root, const SearchLimits& searchLimits,
+                        const std::vector<uint64_t>& gameHistory = std::vector<uint64_t>()) {
+        limits = searchLimits;
+        startTime = std::chrono::steady_clock::now();
+        stopRequested = false;
+        stopped = false;
+        nodes = 0;
+        keyStack = gameHistory;
+        keyStack.push_back(root.getHash());
+        ChessBoard board = root;
+        if (threadIndex < 0) tt->newSearch();
+        for (int ply = 0; ply < MAX_PLY; ply++) {
+            killers[ply][0] = killers[ply][1] = Move();
+        }
+        
+        SearchResult result;
+        MoveList rootMoves;
+        root.generateLegalMoves(rootMoves);
+        if (rootMoves.empty()) {
+            result.score = root.isCheck(root.getCurrentPlayer()) ? -MATE_SCORE : 0;
+            return result;
+        }
+        result.bestMove = rootMoves[0];
+        result.hasMove = true;
+        
+        int maxDepth = (limits.depth > 0) ? std::min(limits.depth, MAX_PLY - 1) : MAX_PLY - 1;
+        int firstDepth = (threadIndex > 0) ? 1 + threadIndex % 2 : 1;
+        for (int depth = std::min(firstDepth, maxDepth); depth <= maxDepth; depth++) {
+            previousBest = result.bestMove;
+            int score = negamax(board, depth, 0, -INFINITE_SCORE, INFINITE_SCORE);
+            //an interrupted iteration is discarded, the last completed one stands
+            if (stopped) break;
+            
+            result.score = score;
+            result.depth = depth;
+            result.pv.assign(pvTable.begin(), pvTable.begin() + pvLength[0]);
+            if (!result.pv.empty()) result.bestMove = result.pv[0];
+            result.nodes = nodes;
+            result.seconds = elapsedSeconds();
+            if (onIteration) onIteration(result);
+            
+            //a forced mate needs no deeper search, unless the search is meant to run until stopped
+            if (!limits.infinite && std::abs(score) >= MATE_SCORE - MAX_PLY &&
+                depth >= MATE_SCORE - std::abs(score)) break;
+        }
+        result.nodes = nodes;
+        result.seconds = elapsedSeconds();
+        return result;
+    }
+    
+    //safe to call from another thread; the search returns its last completed iteration
+    void stop() {
+        stopRequested = true;
+    }
+    
+private:
+    std::unique_ptr<TranspositionTable> ownedTable;
+    TranspositionTable* tt;
+    int threadIndex;
+    const std::atomic<bool>* sharedStop;
+    std::atomic<bool> stopRequested;
+    bool stopped;
+    SearchLimits limits;
+    std::chrono::steady_clock::time_point startTime;
+    uint64_t nodes;
+    std::vector<uint64_t> keyStack; //game history plus the current search line
+    std::vector<Move> pvTable;      //triangular PV table, row ply starts at ply * MAX_PLY
+    std::vector<int> pvLength;
+    Move previousBest;
+    Move killers[MAX_PLY][2];     //quiet moves that last caused a cutoff at each ply
+    int history[3][64][64];       //quiet move success by side, from and to square
+    
+    double elapsedSeconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    }
+    
+    bool checkStop() {
+        if (stopped) return true;
+        if (stopRequested.load(std::memory_order_relaxed) ||
+            (sharedStop && sharedStop->load(std::memory_order_relaxed))) {
+            stopped = true;
+        } else if (limits.nodes > 0 && nodes >= limits.nodes) {
+            stopped = true;
+        } else if (limits.movetimeMs > 0 && (nodes & 1023) == 0 &&
+                   elapsedSeconds() * 1000 >= static_cast<double>(limits.movetimeMs)) {
+            stopped = true;
+        }
+        return stopped;
+    }
+    
+    //fifty-move rule, dead positions and repetitions inside the current line
+    bool isDrawByRule(const ChessBoard& board) const {
+        if (board.getHalfmoveClock() >= 100 || board.isInsufficientMaterial()) {
+            return true;
+        }
+        int last = static_cast<int>(keyStack.size()) - 1;
+        int limit = std::min(board.getHalfmoveClock(), last);
+        for (int back = 4; back <= limit; back += 2) {
+            if (keyStack[last - back] == keyStack[last]) return true;
+        }
+        return false;
+    }
+    
+    void updatePV(int ply, const Move& move) {
+        Move* row = &pvTable[ply * MAX_PLY];
+        const Move* childRow = &pvTable[(ply + 1) * MAX_PLY];
+        row[ply] = move;
+        for (int i = ply + 1; i < pvLength[ply + 1]; i++) {
+            row[i] = childRow[i];
+        }
+        pvLength[ply] = std::max(pvLength[ply + 1], ply + 1);
+    }
+    
+    //mate scores are stored relative to the node so they stay valid at any depth in the tree
+    static int scoreToTable(int score, int ply) {
+        if (score >= MATE_SCORE - MAX_PLY) return score + ply;
+        if (score <= -MATE_SCORE + MAX_PLY) return score - ply;
+        return score;
+    }
+    
+    static int scoreFromTable(int score, int ply) {
+        if (score >= MATE_SCORE - MAX_PLY) return score - ply;
+        if (score <= -MATE_SCORE + MAX_PLY) return score + ply;
+        return score;
+    }
+    
+    //a quiet move that refuted a node becomes a killer at its ply and gains history; the quiets
+    //searched before it lose some, so the ordering follows the refutations that keep working
+    void updateQuietStats(const ChessBoard& board, const Move& move, int ply, int depth,
+                          const MoveList& triedQuiets) {
+        if (killers[ply][0] != move) {
+            killers[ply][1] = killers[ply][0];
+            killers[ply][0] = move;
+        }
+        int (*table)[64] = history[static_cast<int>(board.getCurrentPlayer())];
+        int bonus = std::min(depth * depth, 400);
+        for (const Move& tried : triedQuiets) {
+            int& entry = table[tried.fromSq()][tried.toSq()];
+            entry -= bonus + entry * bonus / MAX_HISTORY;
+        }
+        int& entry = table[move.fromSq()][move.toSq()];
+        entry += bonus - entry * bonus / MAX_HISTORY;
+    }
+    
+    int negamax(ChessBoard& board, int depth, int ply, int alpha, int beta) {
+        pvLength[ply] = ply;
+        if (checkStop()) return 0;
+        if (depth <= 0) return quiescence(board, ply, alpha, beta);
+        nodes++;
+        
+        if (ply > 0 && isDrawByRule(board)) return 0;
+        if (ply >= MAX_PLY - 1) return board.evaluate();
+        
+        //a stored result that is deep enough and fits the window ends the search here
+        TranspositionTable::ProbeResult entry = {0, 0, 0, TranspositionTable::BOUND_NONE};
+        bool hit = tt->probe(board.getHash(), entry);
+        if (hit && ply > 0 && entry.depth >= depth) {
+            int stored = scoreFromTable(entry.score, ply);
+            if (entry.bound == TranspositionTable::BOUND_EXACT ||
+                (entry.bound == TranspositionTable::BOUND_LOWER && stored >= beta) ||
+                (entry.bound == TranspositionTable::BOUND_UPPER && stored <= alpha)) {
+                return stored;
+            }
+        }
+        
+        bool inCheck = board.isCheck(board.getCurrentPlayer());
+        //look one ply deeper when in check so forcing lines are not cut off at the horizon
+        if (inCheck) depth++;
+        
+        //search the previous iteration's best move first at the root, the table's move elsewhere
+        Move preferred = (ply == 0) ? previousBest : (hit ? Move::fromRaw(entry.move) : Move());
+        MovePicker picker(board, preferred, killers[ply], history[static_cast<int>(board.getCurrentPlayer())], false);
+        
+        int originalAlpha = alpha;
+        int bestScore = -INFINITE_SCORE;
+        Move bestMove;
+        MoveList triedQuiets;
+        Move move;
+        while (picker.next(move)) {
+            bool capture = board.isCapture(move);
+            int score;
+            {
+                MoveScope child(board, move);
+                keyStack.push_back(child.board().getHash());
+                score = -negamax(child.board(), depth - 1, ply + 1, -beta, -alpha);
+                keyStack.pop_back();
+            }
+            if (stopped) return 0;
+            
+            if (score > bestScore) {
+                bestScore = score;
+                bestMove = move;
+                if (score > alpha) {
+                    alpha = score;
+                    updatePV(ply, move);
+                    if (alpha >= beta) {
+                        if (!capture) updateQuietStats(board, move, ply, depth, triedQuiets);
+                        break;
+                    }
+                }
+            }
+            if (!capture) triedQuiets.add(move);
+        }
+        if (bestScore == -INFINITE_SCORE) {
+            return inCheck ? -MATE_SCORE + ply : 0;
+        }
+        
+        TranspositionTable::Bound bound = (bestScore >= beta) ? TranspositionTable::BOUND_LOWER
+                                        : (bestScore > originalAlpha) ? TranspositionTable::BOUND_EXACT
+                                        : TranspositionTable::BOUND_UPPER;
+        tt->store(board.getHash(), bestMove.raw(), scoreToTable(bestScore, ply), depth, bound);
+        return bestScore;
+    }
+    
+    //resolve captures (and every evasion when in check) until the position is quiet
+    int quiescence(ChessBoard& board, int ply, int alpha, int beta) {
+        pvLength[ply] = ply;
+        if (checkStop()) return 0;
+        nodes++;
+        if (ply >= MAX_PLY - 1) return board.evaluate();
+        
+        bool inCheck = board.isCheck(board.getCurrentPlayer());
+        int bestScore = -INFINITE_SCORE;
+        if (!inCheck) {
+            bestScore = board.evaluate();
+            if (bestScore >= beta) return bestScore;
+            if (bestScore > alpha) alpha = bestScore;
+        }
+        
+        //out of check only captures that do not lose material are tried; in check every evasion
+        MovePicker picker(board, Move(), nullptr, nullptr, !inCheck);
+        Move move;
+        while (picker.next(move)) {
+            int score;
+            {
+                MoveScope child(board, move);
+                score = -quiescence(child.board(), ply + 1, -beta, -alpha);
+            }
+            if (stopped) return 0;
+            
+            if (score > bestScore) {
+                bestScore = score;
+                if (score > alpha) {
+                    alpha = score;
+                    updatePV(ply, move);
+                    if (alpha >= beta) break;
+                }
+            }
+        }
+        if (inCheck && bestScore == -INFINITE_SCORE) {
+            return -MATE_SCORE + ply;
+        }
+        return bestScore;
+    }
+};
+
+//Lazy SMP: every thread runs the same iterative deepening search on its own board copy and
+//they cooperate only through the shared transposition table. Thread 0 runs on the caller and
+//owns the limits; when it finishes the helpers are aborted and the deepest result is kept.
+class ParallelSearch {
+public:
+    std::function<void(const SearchResult&)> onIteration;
+    
+    ParallelSearch(TranspositionTable& table, int threadCount) : tt(table), abortFlag(false), stopRequested(false) {
+        if (threadCount < 1) threadCount = 1;
+        for (int i = 0; i < threadCount; i++) {
+            engines.push_back(std::unique_ptr<SearchEngine>(new SearchEngine(table)));
+            engines.back()->setThread(i, &abortFlag);
+        }
+        if (threadCount > 1) {
+            pool.reset(new ThreadPool(threadCount - 1));
+        }
+    }
+    
+    int size() const {
+        return static_cast<int>(engines.size());
+    }
+    
+    SearchResult search(const ChessBoard& root, const SearchLimits& limits,
+                        const std::vector<uint64_t>& history = std::vector<uint64_t>()) {
+        tt.newSearch();
+        abortFlag = stopRequested.load();
+        engines[0]->onIteration = onIteration;
+        
+        //helpers run until aborted, only the main thread watches depth and node limits
+        SearchLimits helperLimits;
+        helperLimits.movetimeMs = limits.movetimeMs;
+        std::vector<SearchResult> results(engines.size());
+        for (size_t i = 1; i < engines.size(); i++) {
+            pool->submit([this, i, &root, &helperLimits, &history, &results] {
+                results[i] = engines[i]->search(root, helperLimits, history);
+            });
+        }
+        results[0] = engines[0]->search(root, limits, history);
+        abortFlag = true;
+        if (pool) pool->wait();
+        
+        SearchResult best = results[0];
+        for (size_t i = 1; i < results.size(); i++) {
+            best.nodes += results[i].nodes;
+            if (results[i].hasMove && results[i].depth > best.depth && !results[i].pv.empty()) {
+                best.bestMove = results[i].bestMove;
+                best.score = results[i].score;
+                best.depth = results[i].depth;
+                best.pv = results[i].pv;
+            }
+        }
+        return best;
+    }
+    
+    //safe to call from another thread. The request holds until resetStop, so a stop sent while
+    //the search thread is still starting up is not lost.
+    void stop() {
+        stopRequested = true;
+        abortFlag = true;
+    }
+    
+    void resetStop() {
+        stopRequested = false;
+    }
+    
+private:
+    TranspositionTable& tt;
+    std::atomic<bool> abortFlag;
+    std::atomic<bool> stopRequested;
+    std::vector<std::unique_ptr<SearchEngine>> engines;
+    std::unique_ptr<ThreadPool> pool;
+};
+
+//one engine search report line: depth, score, nodes, speed and principal variation
+//"cp <centipawns>" or "mate <moves>", negative when the side to move is getting mated
+std::string formatScore(int score) {
+    if (std::abs(score) >= SearchEngine::MATE_SCORE - SearchEngine::MAX_PLY) {
+        int plies = SearchEngine::MATE_SCORE - std::abs(score);
+        return "mate " + std::to_string((score > 0) ? (plies + 1) / 2 : -(plies + 1) / 2);
+    }
+    return "cp " + std::to_string(score);
+}
+
+void printSearchResult(const SearchResult& result) {
+    std::cout << "depth " << result.depth << " score " << formatScore(result.score);
+    std::cout << " nodes " << result.nodes << " nps " << result.nodesPerSecond() << " pv";
+    for (const Move& move : result.pv) {
+        std::cout << " " << move.toString();
+    }
+    std::cout << std::endl;
+}
+
+//join the remaining command line arguments back into one FEN string
+std::string joinArguments(int argc, char* argv[], int first) {
+    std::string joined;
+    for (int i = first; i < argc; i++) {
+        if (!joined.empty()) joined += ' ';
+        joined += argv[i];
+    }
+    return joined;
+}
+
+//time to reach depth with 1, 2, 4 ... maxThreads threads, each run starting from an empty table
+void runSearchScaling(const ChessBoard& board, int depth, int maxThreads, size_t tableMegabytes) {
+    TranspositionTable table(tableMegabytes);
+    double baseSeconds = 0;
+    uint64_t baseNps = 0;
+    SearchLimits limits;
+    limits.depth = depth;
+    for (int threads = 1; threads <= maxThreads; threads = (threads * 2 > maxThreads && threads < maxThreads) ? maxThreads : threads * 2) {
+        table.clear();
+        ParallelSearch search(table, threads);
+        SearchResult result = search.search(board, limits);
+        if (threads == 1) {
+            baseSeconds = result.seconds;
+            baseNps = result.nodesPerSecond();
+        }
+        std::cout << threads << " thread(s): depth " << result.depth << " in " << result.seconds << " s, "
+                  << result.nodes << " nodes, " << result.nodesPerSecond() << " nps, time-to-depth speedup "
+                  << (result.seconds > 0 ? baseSeconds / result.seconds : 0) << "x, nps scaling "
+                  << (baseNps > 0 ? static_cast<double>(result.nodesPerSecond()) / baseNps : 0) << "x, best "
+                  << result.bestMove.toString() << std::endl;
+    }
+}
+
+//engineColor plays through the search engine, Color::NONE leaves both sides to the keyboard;
+//with a book the engine plays from it while the position is covered
+int runInteractive(const std::string& fen, Color engineColor, const SearchLimits& limits,
+                   const PolyglotBook* book = nullptr) {
+    ChessGame game;
+    game.start();
+    if (!fen.empty() && !game.loadFEN(fen)) {
+        std::cout << "Invalid FEN: " << fen << std::endl;
+        return 1;
+    }
+    SearchEngine engine;
+    PRNG random(static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()) | 1);
+    
+    std::string input;
+    while (!game.isGameOver()) {
+        game.printBoard();
+        
+        if (game.getCurrentPlayer() == engineColor) {
+            if (book && game.playBookMove(*book, random.rand64())) {
+                std::cout << "Engine plays " << game.getMoveHistory().back().toString() << " from the book" << std::endl;
+                continue;
+            }
+            SearchResult result = engine.search(game.getBoard(), limits, game.getPositionHistory());
+            printSearchResult(result);
+            std::cout << "Engine plays " << result.bestMove.toString() << std::endl;
+            game.makeMove(result.bestMove);
+            continue;
+        }
+        
+        std::cout << "Enter move (e.g., 'e2e4') or 'q' to quit, 'l' for legal moves, 'f' for FEN: ";
+        if (!(std::cin >> input) || input == "q") {
+            break;
+        } else if (input == "l") {
+            game.printLegalMoves();
+        } else if (input == "f") {
+            std::cout << game.getFEN() << std::endl;
+        } else {
+            game.makeMove(input);
+        }
+    }
+    
+    if (game.isGameOver()) {
+        game.printBoard();
+        std::cout << "Game over: " << game.getResult() << std::endl;
+    }
+    
+    return 0;
+}
+
+//engine against itself until the game ends or maxPlies is reached
+int runSelfPlay(const SearchLimits& limits, int maxPlies, const PolyglotBook* book = nullptr) {
+    ChessGame game;
+    game.start();
+    SearchEngine engine;
+    PRNG random(static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()) | 1);
+    uint64_t totalNodes = 0;
+    double totalSeconds = 0;
+    int plies = 0;
+    
+    while (!game.isGameOver() && plies < maxPlies) {
+        if (book && game.playBookMove(*book, random.rand64())) {
+            std::cout << (plies / 2 + 1) << ((plies % 2 == 0) ? ". " : "... ")
+                      << game.getMoveHistory().back().toString() << "  book" << std::endl;
+            plies++;
+            continue;
+        }
+        SearchResult result = engine.search(game.getBoard(), limits, game.getPositionHistory());
+        totalNodes += result.nodes;
+        totalSeconds += result.seconds;
+        std::cout << (plies / 2 + 1) << ((plies % 2 == 0) ? ". " : "... ") << result.bestMove.toString() << "  ";
+        printSearchResult(result);
+        game.makeMove(result.bestMove);
+        plies++;
+    }
+    
+    game.printBoard();
+    std::cout << (game.isGameOver() ? "Game over: " + game.getResult() : "Stopped after " + std::to_string(plies) + " plies")
+              << std::endl;
+    std::cout << "Searched " << totalNodes << " nodes in " << totalSeconds << " s, "
+              << static_cast<uint64_t>(totalNodes / (totalSeconds > 0 ? totalSeconds : 1e-9)) << " nps" << std::endl;
+    return 0;
+}
+
+//one worker of the batch analysis with its own board, engine and table. Both the table and the
+//history are cleared before every search, so a line's result does not depend on which worker
+//took it or what that worker saw before.
+class BatchAnalyzer {
+public:
+    static const size_t TABLE_MEGABYTES = 1;
+    
+    explicit BatchAnalyzer(int depth) : table(TABLE_MEGABYTES, false), engine(table) {
+        limits.depth = depth;
+    }
+    
+    //"<position> ; legal <n> ; <game state> ; bestmove <move> <score> depth <d> nodes <n>" into out,
+    //whose capacity is reused from line to line
+    void analyze(std::string_view line, std::string& out) {
+        out.clear();
+        out.append(positionFields(line));
+        if (!board.fromFEN(line)) {
+            out += " ; invalid\n";
+            return;
+        }
+        const GameStatus& status = board.getStatus();
+        out += " ; legal ";
+        out += std::to_string(status.legalMoveCount);
+        out += " ; ";
+        out += board.getGameState();
+        if (limits.depth > 0 && !status.isGameOver()) {
+            table.clear();
+            engine.clearHistory();
+            SearchResult result = engine.search(board, limits);
+            out += " ; bestmove ";
+            out += result.bestMove.toString();
+            out += ' ';
+            out += formatScore(result.score);
+            out += " depth ";
+            out += std::to_string(result.depth);
+            out += " nodes ";
+            out += std::to_string(result.nodes);
+        }
+        out += '\n';
+    }
+    
+private:
+    //placement, side, castling and en passant: the part EPD and FEN have in common
+    static std::string_view positionFields(std::string_view line) {
+        size_t end = 0;
+        for (int field = 0; field < 4 && end < line.size(); field++) {
+            while (end < line.size() && line[end] == ' ') end++;
+            while (end < line.size() && line[end] != ' ') end++;
+        }
+        return line.substr(0, end);
+    }
+    
+    ChessBoard board;
+    TranspositionTable table;
+    SearchEngine engine;
+    SearchLimits limits;
+};
+
+//analyse a FEN/EPD file line by line, printing one result line per position in input order.
+//Lines are cut out of the mapped file without copying and handed to the workers a window at a
+//time; the workers pull lines off a shared counter so a slow position does not stall the others.
+bool runBatchAnalysis(const std::string& path, int depth, int threadCount) {
+    MappedFile file;
+    if (!file.open(path)) {
+        std::cout << "Cannot read " << path << std::endl;
+        return false;
+    }
+    std::string_view text = file.view();
+    
+    ThreadPool pool(threadCount);
+    std::vector<std::unique_ptr<BatchAnalyzer>> analyzers;
+    for (int i = 0; i < pool.size(); i++) {
+        analyzers.emplace_back(new BatchAnalyzer(depth));
+    }
+    const size_t windowSize = 256 * static_cast<size_t>(pool.size());
+    std::vector<std::string_view> lines;
+    lines.reserve(windowSize);
+    std::vector<std::string> results(windowSize);
+    
+    auto start = std::chrono::steady_clock::now();
+    uint64_t positions = 0;
+    size_t offset = 0;
+    while (offset < text.size()) {
+        lines.clear();
+        while (lines.size() < windowSize && offset < text.size()) {
+            size_t end = text.find('\n', offset);
+            if (end == std::string_view::npos) end = text.size();
+            std::string_view line = text.substr(offset, end - offset);
+            offset = end + 1;
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            while (!line.empty() && line.front() == ' ') line.remove_prefix(1);
+            if (line.empty() || line.front() == '#') continue;
+            lines.push_back(line);
+        }
+        
+        std::atomic<size_t> next(0);
+        for (int t = 0; t < pool.size(); t++) {
+            pool.submit([&, t] {
+                size_t i;
+                while ((i = next.fetch_add(1, std::memory_order_relaxed)) < lines.size()) {
+                    analyzers[t]->analyze(lines[i], results[i]);
+                }
+            });
+        }
+        pool.wait();
+        
+        for (size_t i = 0; i < lines.size(); i++) {
+            std::cout.write(results[i].data(), static_cast<std::streamsize>(results[i].size()));
+        }
+        positions += lines.size();
+    }
+    std::cout.flush();
+    
+    //the summary goes to stderr so stdout stays one line per position
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << positions << " positions in " << seconds << " s, "
+              << static_cast<uint64_t>(positions / (seconds > 0 ? seconds : 1e-9)) << " positions/s with "
+              << pool.size() << " thread(s)" << std::endl;
+    return true;
+}
+
+//compact game records for bulk archives, all numbers little-endian:
+//  file:   "CHGR" version:u16 reserved:u16, then records back to back
+//  record: plies:u16 flags:u8 result:u8 [fenLength:u8 fen] moves
+//Flag bit 0 marks a start position other than the initial one. With bit 1 set every move is
+//one byte, its index in the generateLegalMoves order of the position it is played from;
+//otherwise it is the 16-bit Move encoding. Rank coding halves the size but ties an archive
+//to the generator's move order, so raw coding is the one to keep across engine versions.
+static const char gameRecordMagic[4] = { 'C', 'H', 'G', 'R' };
+static const uint16_t GAME_RECORD_VERSION = 1;
+static const size_t GAME_RECORD_HEADER_SIZE = 8;
+
+struct GameRecord {
+    static const uint8_t CUSTOM_START = 1;
+    static const uint8_t RANK_CODED = 2;
+    
+    std::string_view startFEN; //empty for the initial position
+    GameResult result;
+    bool rankCoded;
+    int plies;
+    const uint8_t* moves;      //points into the buffer the record was decoded from
+    
+    GameRecord() : result(GameResult::UNKNOWN), rankCoded(false), plies(0), moves(nullptr) {}
+};
+
+//append one game to out; false if it cannot be represented (too long, or an illegal history)
+bool encodeGameRecord(const ChessGame& game, GameResult result, bool rankCoded, std::string& out) {
+    const std::vector<Move>& history = game.getMoveHistory();
+    const std::string& fen = game.getStartFEN();
+    if (history.size() > UINT16_MAX || fen.size() > UINT8_MAX) return false;
+    
+    size_t start = out.size();
+    uint8_t flags = (fen.empty() ? 0 : GameRecord::CUSTOM_START) | (rankCoded ? GameRecord::RANK_CODED : 0);
+    out += static_cast<char>(history.size() & 0xFF);
+    out += static_cast<char>(history.size() >> 8);
+    out += static_cast<char>(flags);
+    out += static_cast<char>(result);
+    if (!fen.empty()) {
+        out += static_cast<char>(fen.size());
+        out += fen;
+    }
+    
+    if (!rankCoded) {
+        for (const Move& move : history) {
+            out += static_cast<char>(move.raw() & 0xFF);
+            out += static_cast<char>(move.raw() >> 8);
+        }
+        return true;
+    }
+    ChessBoard board;
+    if (!fen.empty()) board.fromFEN(fen);
+    MoveList legal;
+    for (const Move& move : history) {
+        legal.clear();
+        board.generateLegalMoves(legal);
+        const Move* found = std::find(legal.begin(), legal.end(), move);
+        if (found == legal.end()) {
+            out.resize(start);
+            return false;
+        }
+        out += static_cast<char>(found - legal.begin());
+        board.playMove(move);
+    }
+    return true;
+}
+
+//decode the record at offset and advance past it; false at the end of data or on a truncated record
+bool decodeGameRecord(std::string_view data, size_t& offset, GameRecord& record) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+    size_t at = offset;
+    if (at + 4 > data.size()) return false;
+    record.plies = bytes[at] | (bytes[at + 1] << 8);
+    uint8_t flags = bytes[at + 2];
+    record.result = static_cast<GameResult>(bytes[at + 3] & 3);
+    record.rankCoded = (flags & GameRecord::RANK_CODED) != 0;
+    at += 4;
+    record.startFEN = std::string_view();
+    if (flags & GameRecord::CUSTOM_START) {
+        if (at + 1 > data.size() || at + 1 + bytes[at] > data.size()) return false;
+        record.startFEN = data.substr(at + 1, bytes[at]);
+        at += 1 + bytes[at];
+    }
+    size_t moveBytes = static_cast<size_t>(record.plies) * (record.rankCoded ? 1 : 2);
+    if (at + moveBytes > data.size()) return false;
+    record.moves = bytes + at;
+    offset = at + moveBytes;
+    return true;
+}
+
+//play a record through board, calling visit(board, move) before each move is made; false if the
+//start position or a move does not decode to something legal
+template <typename Visitor>
+bool replayGameRecord(const GameRecord& record, ChessBoard& board, Visitor&& visit) {
+    if (record.startFEN.empty()) {
+        board.resetBoard();
+    } else if (!board.fromFEN(record.startFEN)) {
+        return false;
+    }
+    MoveList legal;
+    for (int ply = 0; ply < record.plies; ply++) {
+        Move move;
+        if (record.rankCoded) {
+            legal.clear();
+            board.generateLegalMoves(legal);
+            if (record.moves[ply] >= legal.size()) return false;
+            move = legal[record.moves[ply]];
+        } else {
+            move = Move::fromRaw(static_cast<uint16_t>(record.moves[2 * ply] | (record.moves[2 * ply + 1] << 8)));
+            if (!board.isLegalMove(move)) return false;
+        }
+        visit(static_cast<const ChessBoard&>(board), move);
+        board.playMove(move);
+    }
+    return true;
+}
+
+//streams records into an archive file, a game at a time
+class GameRecordWriter {
+public:
+    GameRecordWriter() : rankCoded(true), games(0) {}
+    
+    bool open(const std::string& path, bool rankCodedMoves = true) {
+        rankCoded = rankCodedMoves;
+        games = 0;
+        out.open(path, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        char header[GAME_RECORD_HEADER_SIZE] = { gameRecordMagic[0], gameRecordMagic[1], gameRecordMagic[2], gameRecordMagic[3],
+                                                 static_cast<char>(GAME_RECORD_VERSION & 0xFF),
+                                                 static_cast<char>(GAME_RECORD_VERSION >> 8), 0, 0 };
+        out.write(header, sizeof(header));
+        return static_cast<bool>(out);
+    }
+    
+    bool write(const ChessGame& game) {
+        return write(game, game.getOutcome());
+    }
+    
+    bool write(const ChessGame& game, GameResult result) {
+        buffer.clear();
+        return encodeGameRecord(game, result, rankCoded, buffer) && writeEncoded(buffer);
+    }
+    
+    //a record already made by encodeGameRecord with this writer's move coding
+    bool writeEncoded(std::string_view record) {
+        out.write(record.data(), static_cast<std::streamsize>(record.size()));
+        games++;
+        return static_cast<bool>(out);
+    }
+    
+    bool isRankCoded() const {
+        return rankCoded;
+    }
+    
+    bool close() {
+        out.close();
+        return !out.fail();
+    }
+    
+    uint64_t gamesWritten() const {
+        return games;
+    }
+    
+private:
+    std::ofstream out;
+    std::string buffer; //reused, so writing a game allocates nothing once it has grown
+    bool rankCoded;
+    uint64_t games;
+};
+
+//walks the records of a memory-mapped archive without copying them
+class GameRecordReader {
+public:
+    GameRecordReader() : offset(0) {}
+    
+    bool open(const std::string& path) {
+        offset = 0;
+        if (!file.open(path)) return false;
+        data = file.view();
+        if (data.size() < GAME_RECORD_HEADER_SIZE || data.compare(0, 4, std::string_view(gameRecordMagic, 4)) != 0 ||
+            static_cast<uint8_t>(data[4]) != GAME_RECORD_VERSION || data[5] != 0) {
+            return false;
+        }
+        offset = GAME_RECORD_HEADER_SIZE;
+        return true;
+    }
+    
+    bool next(GameRecord& record) {
+        return decodeGameRecord(data, offset, record);
+    }
+    
+    //whether next() stopped at a truncated record rather than the end of the file
+    bool truncated() const {
+        return offset < data.size();
+    }
+    
+    size_t sizeBytes() const {
+        return data.size();
+    }
+    
+private:
+    MappedFile file;
+    std::string_view data;
+    size_t offset;
+};
+
+//archive `games` random games for testing and benchmarks, from a fixed seed so runs repeat
+bool writeRandomGameRecords(const std::string& path, int games, int maxPlies, bool rankCoded) {
+    GameRecordWriter writer;
+    if (!writer.open(path, rankCoded)) {
+        std::cout << "Cannot write " << path << std::endl;
+        return false;
+    }
+    PRNG random(20240601);
+    ChessGame game;
+    uint64_t plies = 0;
+    for (int i = 0; i < games; i++) {
+        game.start();
+        while (!game.isGameOver() && static_cast<int>(game.getMoveHistory().size()) < maxPlies) {
+            MoveList legal = game.getLegalMoves();
+            game.makeMove(legal[static_cast<int>(random.rand64() % legal.size())]);
+        }
+        plies += game.getMoveHistory().size();
+        writer.write(game);
+    }
+    if (!writer.close()) {
+        std::cout << "Cannot write " << path << std::endl;
+        return false;
+    }
+    std::cout << "Wrote " << writer.gamesWritten() << " games, " << plies << " plies" << std::endl;
+    return true;
+}
+
+//replay every game of an archive and report the read throughput
+bool replayGameRecords(const std::string& path) {
+    GameRecordReader reader;
+    if (!reader.open(path)) {
+        std::cout << "Not a game record archive: " << path << std::endl;
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+    ChessBoard board;
+    GameRecord record;
+    uint64_t games = 0;
+    uint64_t plies = 0;
+    uint64_t corrupt = 0;
+    uint64_t results[4] = { 0, 0, 0, 0 };
+    while (reader.next(record)) {
+        if (!replayGameRecord(record, board, [&plies](const ChessBoard&, const Move&) { plies++; })) {
+            corrupt++;
+        }
+        results[static_cast<int>(record.result)]++;
+        games++;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << games << " games, " << plies << " plies in " << seconds << " s, "
+              << static_cast<uint64_t>(plies / (seconds > 0 ? seconds : 1e-9)) << " plies/s, "
+              << (plies ? static_cast<double>(reader.sizeBytes()) / plies : 0) << " bytes/ply" << std::endl;
+    std::cout << "white " << results[1] << ", black " << results[2] << ", draw " << results[3]
+              << ", unfinished " << results[0] << std::endl;
+    if (corrupt || reader.truncated()) {
+        std::cout << corrupt << " corrupt game(s)" << (reader.truncated() ? ", truncated archive" : "") << std::endl;
+        return false;
+    }
+    return true;
+}
+
+//per-position callback of the PGN import: the position before each move, the move, the game's
+//result and the ply of the move within the game. It runs on the import's worker threads, several
+//at a time.
+typedef std::function<void(const ChessBoard&, const Move&, GameResult, int)> PgnPositionVisitor;
+
+struct PgnImportStats {
+    uint64_t games;
+    uint64_t errors;
+    uint64_t plies;
+    uint64_t bytes;
+    double seconds;
+    
+    PgnImportStats() : games(0), errors(0), plies(0), bytes(0), seconds(0) {}
+};
+
+GameResult parsePgnResult(std::string_view text) {
+    if (text == "1-0") return GameResult::WHITE_WINS;
+    if (text == "0-1") return GameResult::BLACK_WINS;
+    if (text == "1/2-1/2") return GameResult::DRAW;
+    return GameResult::UNKNOWN;
+}
+
+const char* pgnResultString(GameResult result) {
+    switch (result) {
+        case GameResult::WHITE_WINS: return "1-0";
+        case GameResult::BLACK_WINS: return "0-1";
+        case GameResult::DRAW: return "1/2-1/2";
+        default: return "*";
+    }
+}
+
+//cut the next game out of PGN text: its tags and movetext, up to the next line starting with
+//'[' after some movetext. Brace comments may span lines, so they are tracked to keep a '[' at
+//the start of a comment line from ending the game.
+bool nextPgnGame(std::string_view data, size_t& offset, std::string_view& game) {
+    size_t start = offset;
+    while (start < data.size() && std::isspace(static_cast<unsigned char>(data[start]))) start++;
+    if (start >= data.size()) {
+        offset = data.size();
+        return false;
+    }
+    bool inMovetext = false;
+    bool inComment = false;
+    size_t at = start;
+    while (at < data.size()) {
+        size_t end = std::min(data.find('\n', at), data.size());
+        std::string_view line = data.substr(at, end - at);
+        if (!inComment && !line.empty() && line.front() == '[') {
+            if (inMovetext) break;
+        } else if (line.find_first_not_of(" \t\r") != std::string_view::npos) {
+            inMovetext = true;
+            size_t brace = 0;
+            while ((brace = line.find(inComment ? '}' : '{', brace)) != std::string_view::npos) {
+                inComment = !inComment;
+                brace++;
+            }
+        }
+        at = end + 1;
+    }
+    at = std::min(at, data.size());
+    game = data.substr(start, at - start);
+    offset = at;
+    return true;
+}
+
+//play one PGN game into game, calling visit (when set) before every move. The result comes from
+//the Result tag, or failing that the termination marker. False on a FEN or move that does not
+//make sense; comments, variations and annotation glyphs are skipped.
+bool parsePgnGame(std::string_view text, ChessGame& game, GameResult& result, const PgnPositionVisitor& visit) {
+    game.start();
+    result = GameResult::UNKNOWN;
+    size_t i = 0;
+    
+    //tag pairs: [Name "Value"]
+    while (true) {
+        while (i < text.size() && std::isspace(static_cast<unsigned char>(text[i]))) i++;
+        if (i >= text.size() || text[i] != '[') break;
+        size_t at = i + 1;
+        while (at < text.size() && text[at] != '"' && !std::isspace(static_cast<unsigned char>(text[at]))) at++;
+        std::string_view name = text.substr(i + 1, at - i - 1);
+        while (at < text.size() && std::isspace(static_cast<unsigned char>(text[at]))) at++;
+        if (at >= text.size() || text[at] != '"') return false;
+        //inside a value a quote or a backslash is escaped with a backslash
+        std::string value;
+        for (at++; at < text.size() && text[at] != '"'; at++) {
+            if (text[at] == '\\' && at + 1 < text.size() && (text[at + 1] == '"' || text[at + 1] == '\\')) at++;
+            value += text[at];
+        }
+        size_t close = (at < text.size()) ? text.find(']', at) : std::string_view::npos;
+        if (close == std::string_view::npos) return false;
+        if (name == "FEN" && !game.loadFEN(value)) return false;
+        if (name == "Result") result = parsePgnResult(value);
+        i = close + 1;
+    }
+    if (result == GameResult::UNKNOWN) {
+        size_t last = text.find_last_not_of(" \t\r\n");
+        if (last != std::string_view::npos) {
+            size_t first = text.find_last_of(" \t\r\n", last);
+            first = (first == std::string_view::npos) ? 0 : first + 1;
+            result = parsePgnResult(text.substr(first, last + 1 - first));
+        }
+    }
+    
+    while (i < text.size()) {
+        char c = text[i];
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            i++;
+        } else if (c == '{') {
+            i = std::min(text.find('}', i), text.size() - 1) + 1;
+        } else if (c == ';') {
+            i = std::min(text.find('\n', i), text.size() - 1) + 1;
+        } else if (c == '(') {
+            //variations nest and may hold comments with parentheses in them
+            int depth = 0;
+            for (; i < text.size(); i++) {
+                if (text[i] == '{') {
+                    i = std::min(text.find('}', i), text.size() - 1);
+                } else if (text[i] == '(') {
+                    depth++;
+                } else if (text[i] == ')' && --depth == 0) {
+                    break;
+                }
+            }
+            i++;
+        } else if (c == '$' || c == ')' || c == '}') {
+            i++;
+            while (i < text.size() && std::isdigit(static_cast<unsigned char>(text[i]))) i++;
+        } else {
+            size_t start = i;
+            while (i < text.size() && !std::isspace(static_cast<unsigned char>(text[i])) &&
+                   text[i] != '{' && text[i] != '(' && text[i] != ')' && text[i] != ';') {
+                i++;
+            }
+            std::string_view token = text.substr(start, i - start);
+            if (token == "*" || parsePgnResult(token) != GameResult::UNKNOWN) break;
+            //move numbers, also when glued to the move as in "12.e4" or "12...Nf6"
+            size_t digits = 0;
+            while (digits < token.size() && std::isdigit(static_cast<unsigned char>(token[digits]))) digits++;
+            if (digits < token.size() && token[digits] == '.') token.remove_prefix(digits);
+            while (!token.empty() && token.front() == '.') token.remove_prefix(1);
+            if (token.empty()) continue;
+            
+            Move move;
+            if (!game.getBoard().parseSAN(token, move)) return false;
+            if (visit) visit(game.getBoard(), move, result, static_cast<int>(game.getMoveHistory().size()));
+            game.playLegalMove(move);
+        }
+    }
+    return true;
+}
+
+//import a PGN file. Games are cut out of the mapped text on the calling thread and parsed by the
+//workers a window at a time, so with a writer the archive keeps the input order.
+bool importPgn(const std::string& path, int threadCount, GameRecordWriter* writer,
+               const PgnPositionVisitor& visit, PgnImportStats& stats) {
+    MappedFile file;
+    if (!file.open(path)) return false;
+    std::string_view text = file.view();
+    auto start = std::chrono::steady_clock::now();
+    
+    struct Worker {
+        ChessGame game;
+        uint64_t plies;
+        uint64_t errors;
+        
+        Worker() : plies(0), errors(0) {}
+    };
+    ThreadPool pool(threadCount);
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (int i = 0; i < pool.size(); i++) {
+        workers.emplace_back(new Worker());
+    }
+    const size_t windowSize = 1024 * static_cast<size_t>(pool.size());
+    std::vector<std::string_view> games;
+    games.reserve(windowSize);
+    std::vector<std::string> records(windowSize);
+    bool written = true;
+    
+    size_t offset = 0;
+    std::string_view game;
+    while (written) {
+        games.clear();
+        while (games.size() < windowSize && nextPgnGame(text, offset, game)) {
+            games.push_back(game);
+        }
+        if (games.empty()) break;
+        
+        std::atomic<size_t> next(0);
+        for (int t = 0; t < pool.size(); t++) {
+            pool.submit([&, t] {
+                Worker& worker = *workers[t];
+                size_t i;
+                while ((i = next.fetch_add(1, std::memory_order_relaxed)) < games.size()) {
+                    GameResult result;
+                    records[i].clear();
+                    if (!parsePgnGame(games[i], worker.game, result, visit) ||
+                        (writer && !encodeGameRecord(worker.game, result, writer->isRankCoded(), records[i]))) {
+                        worker.errors++;
+                        records[i].clear();
+                        continue;
+                    }
+                    worker.plies += worker.game.getMoveHistory().size();
+                }
+            });
+        }
+        pool.wait();
+        
+        for (size_t i = 0; writer && i < games.size(); i++) {
+            if (!records[i].empty() && !writer->writeEncoded(records[i])) {
+                written = false;
+                break;
+            }
+        }
+        stats.games += games.size();
+    }
+    
+    for (const auto& worker : workers) {
+        stats.plies += worker->plies;
+        stats.errors += worker->errors;
+    }
+    stats.bytes = text.size();
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return written;
+}
+
+//print an archive as PGN, the moves in SAN
+bool exportGameRecordsAsPgn(const std::string& path) {
+    GameRecordReader reader;
+    if (!reader.open(path)) {
+        std::cout << "Not a game record archive: " << path << std::endl;
+        return false;
+    }
+    ChessBoard board;
+    GameRecord record;
+    std::string pgn;
+    std::string line;
+    uint64_t games = 0;
+    while (reader.next(record)) {
+        games++;
+        pgn.clear();
+        pgn += "[Event \"Game " + std::to_string(games) + "\"]\n";
+        if (!record.startFEN.empty()) {
+            pgn += "[SetUp \"1\"]\n[FEN \"" + std::string(record.startFEN) + "\"]\n";
+        }
+        pgn += std::string("[Result \"") + pgnResultString(record.result) + "\"]\n\n";
+        line.clear();
+        auto addWord = [&pgn, &line](const std::string& word) {
+            if (!line.empty() && line.size() + 1 + word.size() > 79) {
+                pgn += line + "\n";
+                line.clear();
+            }
+            if (!line.empty()) line += ' ';
+            line += word;
+        };
+        bool first = true;
+        bool valid = replayGameRecord(record, board, [&](const ChessBoard& position, const Move& move) {
+            if (position.getCurrentPlayer() == Color::WHITE) {
+                addWord(std::to_string(position.getFullmoveNumber()) + ".");
+            } else if (first) {
+                addWord(std::to_string(position.getFullmoveNumber()) + "...");
+            }
+            first = false;
+            addWord(position.toSAN(move));
+        });
+        if (!valid) {
+            std::cout << "Corrupt game " << games << std::endl;
+            return false;
+        }
+        addWord(pgnResultString(record.result));
+        pgn += line + "\n\n";
+        std::cout.write(pgn.data(), static_cast<std::streamsize>(pgn.size()));
+    }
+    return !reader.truncated();
+}
+
+//how often one position occurs over a game corpus, with the results from White's point of view
+struct PositionEntry {
+    uint64_t key;
+    uint32_t count;
+    uint32_t whiteWins;
+    uint32_t draws;
+    uint32_t blackWins;
+    
+    void add(const PositionEntry& other) {
+        count += other.count;
+        whiteWins += other.whiteWins;
+        draws += other.draws;
+        blackWins += other.blackWins;
+    }
+};
+
+static_assert(sizeof(PositionEntry) == 24, "index entries are written and mapped as raw bytes");
+
+//position index file, in native byte order so it can be mapped as is:
+//  "CHPI" version:u32 entries:u64, then 65537 u64 directory offsets, one per value of the top
+//  16 key bits plus an end marker, then the entries sorted by key
+static const char positionIndexMagic[4] = { 'C', 'H', 'P', 'I' };
+static const uint32_t POSITION_INDEX_VERSION = 2;
+static const int POSITION_INDEX_DIRECTORY_BITS = 16;
+static const size_t POSITION_INDEX_DIRECTORY_SIZE = (size_t(1) << POSITION_INDEX_DIRECTORY_BITS) + 1;
+static const size_t POSITION_INDEX_HEADER_SIZE = 16;
+
+//read side of the position index: a lookup is one directory step and a binary search over the
+//few entries sharing the key's top 16 bits, all in the mapped file
+class PositionIndex {
+public:
+    PositionIndex() : directory(nullptr), entries(nullptr), entryCount(0) {}
+    
+    bool open(const std::string& path) {
+        entryCount = 0;
+        if (!file.open(path)) return false;
+        std::string_view data = file.view();
+        size_t entriesOffset = POSITION_INDEX_HEADER_SIZE + POSITION_INDEX_DIRECTORY_SIZE * sizeof(uint64_t);
+        if (data.size() < entriesOffset || data.compare(0, 4, std::string_view(positionIndexMagic, 4)) != 0) {
+            return false;
+        }
+        uint32_t version;
+        uint64_t count;
+        std::memcpy(&version, data.data() + 4, sizeof(version));
+        std::memcpy(&count, data.data() + 8, sizeof(count));
+        if (version != POSITION_INDEX_VERSION || data.size() != entriesOffset + count * sizeof(PositionEntry)) {
+            return false;
+        }
+        directory = reinterpret_cast<const uint64_t*>(data.data() + POSITION_INDEX_HEADER_SIZE);
+        entries = reinterpret_cast<const PositionEntry*>(data.data() + entriesOffset);
+        entryCount = count;
+        return directory[POSITION_INDEX_DIRECTORY_SIZE - 1] == count;
+    }
+    
+    bool lookup(uint64_t key, PositionEntry& entry) const {
+        if (entryCount == 0) return false;
+        uint64_t bucket = key >> (64 - POSITION_INDEX_DIRECTORY_BITS);
+        const PositionEntry* first = entries + directory[bucket];
+        const PositionEntry* last = entries + directory[bucket + 1];
+        const PositionEntry* found = std::lower_bound(first, last, key,
+            [](const PositionEntry& candidate, uint64_t wanted) { return candidate.key < wanted; });
+        if (found == last || found->key != key) return false;
+        entry = *found;
+        return true;
+    }
+    
+    bool lookup(const ChessBoard& board, PositionEntry& entry) const {
+        return lookup(board.positionKey(), entry);
+    }
+    
+    uint64_t size() const {
+        return entryCount;
+    }
+    
+private:
+    MappedFile file;
+    const uint64_t* directory;
+    const PositionEntry* entries;
+    uint64_t entryCount;
+};
+
+//builds a PositionIndex from game-record archives in two passes. Replay: workers play the games
+//and collect one entry per position, partitioned into shards by the top key bits; a worker past
+//its share of the memory budget sorts, combines and spills every shard to a run file. Merge: the
+//runs of each shard, on disk or still in memory, are k-way merged on a thread of their own, and
+//as the shards cover consecutive key ranges their outputs are simply concatenated.
+class PositionIndexBuilder {
+public:
+    static const int SHARD_BITS = 4;
+    static const int SHARDS = 1 << SHARD_BITS;
+    
+    //positions from ply maxPly on are left out when maxPly > 0, as opening statistics want
+    PositionIndexBuilder(const std::string& output, int threadCount, size_t memoryMegabytes, int maxPly)
+        : outputPath(output), pool(threadCount), plyLimit(maxPly), games(0), uniquePositions(0),
+          runsSpilled(0), failed(false) {
+        size_t entriesPerWorker = memoryMegabytes * 1024 * 1024 / sizeof(PositionEntry) / pool.size();
+        for (int i = 0; i < pool.size(); i++) {
+            workers.emplace_back(new Worker(i, std::max<size_t>(entriesPerWorker, 4096)));
+        }
+    }
+    
+    ~PositionIndexBuilder() {
+        removeRuns();
+    }
+    
+    //replay every game of an archive into the shards; false if it cannot be read or a run cannot be written
+    bool addArchive(const std::string& archivePath) {
+        GameRecordReader reader;
+        if (!reader.open(archivePath)) return false;
+        const size_t windowSize = 1024 * static_cast<size_t>(pool.size());
+        std::vector<GameRecord> window;
+        window.reserve(windowSize);
+        GameRecord record;
+        bool more = true;
+        while (more && !failed) {
+            window.clear();
+            while (window.size() < windowSize && (more = reader.next(record))) {
+                window.push_back(record);
+            }
+            std::atomic<size_t> next(0);
+            for (int t = 0; t < pool.size(); t++) {
+                pool.submit([this, t, &window, &next] {
+                    size_t i;
+                    while ((i = next.fetch_add(1, std::memory_order_relaxed)) < window.size()) {
+                        replay(*workers[t], window[i]);
+                    }
+                });
+            }
+            pool.wait();
+            games += window.size();
+        }
+        return !failed && !reader.truncated();
+    }
+    
+    //merge everything collected so far and write the index file
+    bool finish() {
+        if (failed) return false;
+        std::vector<uint64_t> bucketCounts(POSITION_INDEX_DIRECTORY_SIZE - 1, 0);
+        std::vector<uint64_t> shardCounts(SHARDS, 0);
+        std::vector<std::string> shardFiles(SHARDS);
+        for (int shard = 0; shard < SHARDS; shard++) {
+            shardFiles[shard] = outputPath + ".shard-" + std::to_string(shard);
+            pool.submit([this, shard, &bucketCounts, &shardCounts, &shardFiles] {
+                if (!mergeShard(shard, shardFiles[shard], bucketCounts, shardCounts[shard])) failed = true;
+            });
+        }
+        pool.wait();
+        
+        bool written = !failed && writeIndex(shardFiles, bucketCounts);
+        for (const std::string& path : shardFiles) std::remove(path.c_str());
+        removeRuns();
+        for (uint64_t count : shardCounts) uniquePositions += count;
+        return written;
+    }
+    
+    uint64_t gameCount() const {
+        return games;
+    }
+    
+    uint64_t positionCount() const {
+        uint64_t total = 0;
+        for (const auto& worker : workers) total += worker->positions;
+        return total;
+    }
+    
+    uint64_t uniquePositionCount() const {
+        return uniquePositions;
+    }
+    
+    uint64_t runCount() const {
+        uint64_t total = 0;
+        for (const auto& worker : workers) {
+            for (const auto& runs : worker->runFiles) total += runs.size();
+        }
+        return total + runsSpilled;
+    }
+    
+private:
+    struct Worker {
+        int id;
+        size_t capacity;                          //entries buffered before a spill
+        size_t buffered;
+        std::vector<PositionEntry> shards[SHARDS];
+        std::vector<std::string> runFiles[SHARDS];
+        ChessBoard board;
+        uint64_t positions;
+        
+        Worker(int index, size_t entries) : id(index), capacity(entries), buffered(0), positions(0) {}
+    };
+    
+    std::string outputPath;
+    ThreadPool pool;
+    std::vector<std::unique_ptr<Worker>> workers;
+    int plyLimit;
+    uint64_t games;
+    uint64_t uniquePositions;
+    uint64_t runsSpilled;
+    std::atomic<bool> failed;
+    
+    void replay(Worker& worker, const GameRecord& record) {
+        PositionEntry tally = {};
+        tally.count = 1;
+        tally.whiteWins = (record.result == GameResult::WHITE_WINS);
+        tally.draws = (record.result == GameResult::DRAW);
+        tally.blackWins = (record.result == GameResult::BLACK_WINS);
+        auto collect = [&](uint64_t key) {
+            tally.key = key;
+            worker.shards[key >> (64 - SHARD_BITS)].push_back(tally);
+            worker.positions++;
+            if (++worker.buffered >= worker.capacity) spill(worker);
+        };
+        //the game is only played as far as the ply limit; the final position counts if it is inside
+        GameRecord played = record;
+        if (plyLimit > 0) played.plies = std::min(played.plies, plyLimit);
+        bool valid = replayGameRecord(played, worker.board, [&](const ChessBoard& position, const Move&) {
+            collect(position.positionKey());
+        });
+        //a corrupt game still counts up to the point it broke off, like a truncated PGN game would
+        if (valid && (plyLimit <= 0 || record.plies < plyLimit)) collect(worker.board.positionKey());
+    }
+    
+    static void sortAndCombine(std::vector<PositionEntry>& entries) {
+        std::sort(entries.begin(), entries.end(),
+                  [](const PositionEntry& a, const PositionEntry& b) { return a.key < b.key; });
+        size_t kept = 0;
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (kept > 0 && entries[kept - 1].key == entries[i].key) {
+                entries[kept - 1].add(entries[i]);
+            } else {
+                entries[kept++] = entries[i];
+            }
+        }
+        entries.resize(kept);
+    }
+    
+    void spill(Worker& worker) {
+        for (int shard = 0; shard < SHARDS; shard++) {
+            std::vector<PositionEntry>& entries = worker.shards[shard];
+            if (entries.empty()) continue;
+            sortAndCombine(entries);
+            std::string path = outputPath + ".run-" + std::to_string(shard) + "-" + std::to_string(worker.id) + "-" +
+                               std::to_string(worker.runFiles[shard].size());
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<const char*>(entries.data()),
+                      static_cast<std::streamsize>(entries.size() * sizeof(PositionEntry)));
+            if (!out) failed = true;
+            worker.runFiles[shard].push_back(path);
+            entries.clear();
+        }
+        worker.buffered = 0;
+    }
+    
+    //k-way merge of one shard's runs into a file of unique, sorted entries. Each shard only touches
+    //its own buffers and its own range of bucketCounts, so the shards merge in parallel.
+    bool mergeShard(int shard, const std::string& path, std::vector<uint64_t>& bucketCounts, uint64_t& unique) {
+        struct Cursor {
+            const PositionEntry* at;
+            const PositionEntry* end;
+        };
+        std::vector<std::unique_ptr<MappedFile>> runs;
+        std::vector<Cursor> heap;
+        for (auto& worker : workers) {
+            for (const std::string& runPath : worker->runFiles[shard]) {
+                runs.emplace_back(new MappedFile());
+                if (!runs.back()->open(runPath)) return false;
+                std::string_view bytes = runs.back()->view();
+                const PositionEntry* begin = reinterpret_cast<const PositionEntry*>(bytes.data());
+                if (!bytes.empty()) heap.push_back(Cursor{ begin, begin + bytes.size() / sizeof(PositionEntry) });
+            }
+            std::vector<PositionEntry>& memory = worker->shards[shard];
+            sortAndCombine(memory);
+            if (!memory.empty()) heap.push_back(Cursor{ memory.data(), memory.data() + memory.size() });
+        }
+        
+        auto later = [](const Cursor& a, const Cursor& b) { return a.at->key > b.at->key; };
+        std::make_heap(heap.begin(), heap.end(), later);
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        std::vector<PositionEntry> buffer;
+        buffer.reserve(1 << 16);
+        auto flush = [&out, &buffer] {
+            out.write(reinterpret_cast<const char*>(buffer.data()),
+                      static_cast<std::streamsize>(buffer.size() * sizeof(PositionEntry)));
+            buffer.clear();
+        };
+        auto emit = [&](const PositionEntry& entry) {
+            bucketCounts[entry.key >> (64 - POSITION_INDEX_DIRECTORY_BITS)]++;
+            unique++;
+            buffer.push_back(entry);
+            if (buffer.size() == buffer.capacity()) flush();
+        };
+        
+        PositionEntry current = {};
+        bool pending = false;
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), later);
+            Cursor& cursor = heap.back();
+            if (pending && cursor.at->key == current.key) {
+                current.add(*cursor.at);
+            } else {
+                if (pending) emit(current);
+                current = *cursor.at;
+                pending = true;
+            }
+            if (++cursor.at == cursor.end) {
+                heap.pop_back();
+            } else {
+                std::push_heap(heap.begin(), heap.end(), later);
+            }
+        }
+        if (pending) emit(current);
+        flush();
+        for (auto& worker : workers) {
+            std::vector<PositionEntry>().swap(worker->shards[shard]);
+        }
+        return static_cast<bool>(out);
+    }
+    
+    bool writeIndex(const std::vector<std::string>& shardFiles, const std::vector<uint64_t>& bucketCounts) {
+        std::vector<uint64_t> directory(POSITION_INDEX_DIRECTORY_SIZE, 0);
+        for (size_t i = 0; i + 1 < directory.size(); i++) {
+            directory[i + 1] = directory[i] + bucketCounts[i];
+        }
+        uint64_t count = directory.back();
+        std::ofstream out(outputPath, std::ios::binary | std::ios::trunc);
+        out.write(positionIndexMagic, 4);
+        out.write(reinterpret_cast<const char*>(&POSITION_INDEX_VERSION), sizeof(POSITION_INDEX_VERSION));
+        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        out.write(reinterpret_cast<const char*>(directory.data()),
+                  static_cast<std::streamsize>(directory.size() * sizeof(uint64_t)));
+        for (const std::string& path : shardFiles) {
+            MappedFile shard;
+            if (!shard.open(path)) return false;
+            std::string_view bytes = shard.view();
+            out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        }
+        out.close();
+        return !out.fail();
+    }
+    
+    void removeRuns() {
+        for (auto& worker : workers) {
+            for (auto& runs : worker->runFiles) {
+                runsSpilled += runs.size();
+                for (const std::string& path : runs) std::remove(path.c_str());
+                runs.clear();
+            }
+        }
+    }
+};
+
+//position statistics of one board and of every position a legal move leads to, most played first
+bool probePositionIndex(const std::string& indexPath, const std::string& fen) {
+    PositionIndex index;
+    if (!index.open(indexPath)) {
+        std::cout << "Not a position index: " << indexPath << std::endl;
+        return false;
+    }
+    ChessBoard board;
+    if (!fen.empty() && !board.fromFEN(fen)) {
+        std::cout << "Invalid FEN: " << fen << std::endl;
+        return false;
+    }
+    auto describe = [](const PositionEntry& entry) {
+        uint32_t decided = entry.whiteWins + entry.draws + entry.blackWins;
+        std::string text = "count " + std::to_string(entry.count);
+        if (decided > 0) {
+            text += ", white " + std::to_string(entry.whiteWins * 100 / decided) + "%, draw " +
+                    std::to_string(entry.draws * 100 / decided) + "%, black " +
+                    std::to_string(entry.blackWins * 100 / decided) + "%";
+        }
+        return text;
+    };
+    
+    PositionEntry entry;
+    if (!index.lookup(board, entry)) {
+        std::cout << "Position not in the index (" << index.size() << " positions)" << std::endl;
+        return true;
+    }
+    std::cout << "Position: " << describe(entry) << std::endl;
+    std::vector<std::pair<PositionEntry, Move>> continuations;
+    MoveList moves;
+    board.generateLegalMoves(moves);
+    for (const Move& move : moves) {
+        ChessBoard next(board);
+        next.playMove(move);
+        if (index.lookup(next, entry)) continuations.push_back(std::make_pair(entry, move));
+    }
+    std::sort(continuations.begin(), continuations.end(),
+              [](const std::pair<PositionEntry, Move>& a, const std::pair<PositionEntry, Move>& b) {
+                  return a.first.count > b.first.count;
+              });
+    for (const auto& continuation : continuations) {
+        std::cout << board.toSAN(continuation.second) << ": " << describe(continuation.first) << std::endl;
+    }
+    return true;
+}
+
+//write a Polyglot book from a game-record archive or a PGN file. Every move of the first maxPly
+//plies scores 2 for a win and 1 for a draw of the side that played it, as Polyglot's own
+//make-book does; games without a result count as draws. Moves played fewer than minGames times
+//are left out, and a position's weights are scaled down together when they overflow 16 bits.
+bool buildPolyglotBook(const std::string& input, const std::string& output, int maxPly, int minGames) {
+    struct Tally {
+        uint64_t key;
+        uint64_t weight;
+        uint32_t games;
+        uint16_t move;
+    };
+    std::vector<Tally> tallies;
+    auto add = [&tallies](const ChessBoard& position, const Move& move, GameResult result) {
+        bool white = position.getCurrentPlayer() == Color::WHITE;
+        uint64_t weight = 1;
+        if (result == GameResult::WHITE_WINS) weight = white ? 2 : 0;
+        if (result == GameResult::BLACK_WINS) weight = white ? 0 : 2;
+        tallies.push_back(Tally{ position.polyglotKey(), weight, 1, position.toPolyglotMove(move) });
+    };
+    
+    //a game that breaks off partway is dropped whole, so its moves are taken back out of tallies
+    uint64_t games = 0;
+    uint64_t rejected = 0;
+    GameRecordReader reader;
+    if (reader.open(input)) {
+        ChessBoard board;
+        GameRecord record;
+        while (reader.next(record)) {
+            games++;
+            size_t mark = tallies.size();
+            record.plies = std::min(record.plies, maxPly);
+            if (!replayGameRecord(record, board, [&](const ChessBoard& position, const Move& move) {
+                    add(position, move, record.result);
+                })) {
+                tallies.resize(mark);
+                rejected++;
+            }
+        }
+    } else {
+        MappedFile file;
+        if (!file.open(input)) {
+            std::cout << "Cannot read " << input << std::endl;
+            return false;
+        }
+        ChessGame game;
+        GameResult gameResult;
+        PgnPositionVisitor visit = [&](const ChessBoard& position, const Move& move, GameResult result, int ply) {
+            if (ply < maxPly) add(position, move, result);
+        };
+        size_t offset = 0;
+        std::string_view text;
+        while (nextPgnGame(file.view(), offset, text)) {
+            games++;
+            size_t mark = tallies.size();
+            if (!parsePgnGame(text, game, gameResult, visit)) {
+                tallies.resize(mark);
+                rejected++;
+            }
+        }
+    }
+    
+    std::sort(tallies.begin(), tallies.end(), [](const Tally& a, const Tally& b) {
+        return a.key < b.key || (a.key == b.key && a.move < b.move);
+    });
+    size_t kept = 0;
+    for (size_t i = 0; i < tallies.size(); i++) {
+        if (kept > 0 && tallies[kept - 1].key == tallies[i].key && tallies[kept - 1].move == tallies[i].move) {
+            tallies[kept - 1].games += tallies[i].games;
+            tallies[kept - 1].weight += tallies[i].weight;
+        } else {
+            tallies[kept++] = tallies[i];
+        }
+    }
+    tallies.resize(kept);
+    
+    std::ofstream out(output, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cout << "Cannot write " << output << std::endl;
+        return false;
+    }
+    uint64_t entries = 0;
+    uint64_t positions = 0;
+    for (size_t first = 0; first < tallies.size();) {
+        size_t last = first;
+        uint64_t heaviest = 0;
+        while (last < tallies.size() && tallies[last].key == tallies[first].key) {
+            if (static_cast<int>(tallies[last].games) >= minGames) heaviest = std::max(heaviest, tallies[last].weight);
+            last++;
+        }
+        //heaviest move first within a position, as Polyglot books are ordered
+        std::sort(tallies.begin() + first, tallies.begin() + last,
+                  [](const Tally& a, const Tally& b) { return a.weight > b.weight; });
+        bool written = false;
+        for (size_t i = first; i < last; i++) {
+            uint64_t weight = (heaviest > UINT16_MAX) ? tallies[i].weight * UINT16_MAX / heaviest : tallies[i].weight;
+            if (static_cast<int>(tallies[i].games) < minGames || weight == 0) continue;
+            uint8_t entry[PolyglotBook::ENTRY_SIZE] = {};
+            for (int b = 0; b < 8; b++) entry[b] = static_cast<uint8_t>(tallies[i].key >> (56 - 8 * b));
+            entry[8] = static_cast<uint8_t>(tallies[i].move >> 8);
+            entry[9] = static_cast<uint8_t>(tallies[i].move);
+            entry[10] = static_cast<uint8_t>(weight >> 8);
+            entry[11] = static_cast<uint8_t>(weight);
+            out.write(reinterpret_cast<const char*>(entry), sizeof(entry));
+            entries++;
+            written = true;
+        }
+        positions += written;
+        first = last;
+    }
+    out.close();
+    if (out.fail()) {
+        std::cout << "Cannot write " << output << std::endl;
+        return false;
+    }
+    std::cout << "Book " << output << ": " << entries << " moves in " << positions << " positions from "
+              << games << " games (" << rejected << " rejected)" << std::endl;
+    return true;
+}
+
+//the book moves of a position with their share of the weight
+bool probePolyglotBook(const std::string& path, const std::string& fen) {
+    PolyglotBook book;
+    if (!book.open(path)) {
+        std::cout << "Not a Polyglot book: " << path << std::endl;
+        return false;
+    }
+    ChessBoard board;
+    if (!fen.empty() && !board.fromFEN(fen)) {
+        std::cout << "Invalid FEN: " << fen << std::endl;
+        return false;
+    }
+    Move moves[MoveList::CAPACITY];
+    int weights[MoveList::CAPACITY];
+    int count = book.probe(board, moves, weights, MoveList::CAPACITY);
+    int total = 0;
+    for (int i = 0; i < count; i++) total += weights[i];
+    std::cout << "key " << std::hex << board.polyglotKey() << std::dec << ", " << count << " book move(s)" << std::endl;
+    for (int i = 0; i < count; i++) {
+        std::cout << board.toSAN(moves[i]) << " (" << moves[i].toString() << "): weight " << weights[i] << ", "
+                  << (weights[i] * 100.0 / total) << "%" << std::endl;
+    }
+    
+    //probe cost, the figure that matters when every self-play move asks the book first
+    const int probes = 100000;
+    PRNG random(1);
+    Move picked;
+    uint64_t hits = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < probes; i++) hits += book.pickMove(board, random.rand64(), picked);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "pickMove: " << (seconds * 1e9 / probes) << " ns per probe over " << book.size() << " entries ("
+              << hits << " hits)" << std::endl;
+    return true;
+}
+
+//protocol output for the UCI front-end: every message is assembled in memory and written with
+//one flush, and the lock keeps lines of the command loop and the search thread from interleaving
+class UciOutput {
+public:
+    void send(const std::string& message) {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        std::cout.write(message.data(), static_cast<std::streamsize>(message.size()));
+        std::cout.flush();
+    }
+    
+private:
+    std::mutex outputMutex;
+};
+
+//"info ..." line for one completed iteration
+std::string formatUciInfo(const SearchResult& result, int hashfull) {
+    std::string line = "info depth " + std::to_string(result.depth) + " score " + formatScore(result.score);
+    line += " nodes " + std::to_string(result.nodes) + " nps " + std::to_string(result.nodesPerSecond()) +
+            " time " + std::to_string(static_cast<int64_t>(result.seconds * 1000)) +
+            " hashfull " + std::to_string(hashfull) + " pv";
+    for (const Move& move : result.pv) {
+        line += ' ';
+        line += move.toString();
+    }
+    line += '\n';
+    return line;
+}
+
+//Universal Chess Interface front-end for GUIs and tournament managers. The main thread keeps
+//reading commands while a search runs on its own thread, so stop and isready answer at once.
+class UciSession {
+public:
+    UciSession() : table(16), threadCount(1), search(new ParallelSearch(table, 1)),
+                   random(static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()) | 1) {
+        game.start();
+    }
+    
+    ~UciSession() {
+        stopSearch();
+    }
+    
+    int run() {
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            if (!handle(line)) break;
+        }
+        stopSearch();
+        return 0;
+    }
+    
+private:
+    TranspositionTable table;
+    int threadCount;
+    std::unique_ptr<ParallelSearch> search;
+    std::thread searchThread;
+    ChessGame game;
+    UciOutput output;
+    PolyglotBook book;
+    PRNG random;
+    std::string heldBestMove;   //the answer to go infinite, sent only once stop arrives
+    
+    //false on quit
+    bool handle(const std::string& line) {
+        std::vector<std::string> tokens;
+        size_t i = 0;
+        while (i < line.size()) {
+            while (i < line.size() && std::isspace(static_cast<unsigned char>(line[i]))) i++;
+            size_t start = i;
+            while (i < line.size() && !std::isspace(static_cast<unsigned char>(line[i]))) i++;
+            if (i > start) tokens.push_back(line.substr(start, i - start));
+        }
+        if (tokens.empty()) return true;
+        const std::string& command = tokens[0];
+        
+        if (command == "uci") {
+            output.send("id name Chess Logic\nid author Chess Logic contributors\n"
+                        "option name Hash type spin default 16 min 1 max 65536\n"
+                        "option name Threads type spin default 1 min 1 max 512\n"
+                        "option name BookFile type string default <empty>\n"
+                        "uciok\n");
+        } else if (command == "isready") {
+            output.send("readyok\n");
+        } else if (command == "ucinewgame") {
+            stopSearch();
+            table.clear();
+            game.start();
+        } else if (command == "setoption") {
+            stopSearch();
+            setOption(tokens);
+        } else if (command == "position") {
+            stopSearch();
+            setPosition(tokens);
+        } else if (command == "go") {
+            stopSearch();
+            startSearch(tokens);
+        } else if (command == "stop") {
+            stopSearch();
+        } else if (command == "quit") {
+            return false;
+        }
+        return true;
+    }
+    
+    //setoption name <name> value <value>
+    void setOption(const std::vector<std::string>& tokens) {
+        std::string name;
+        std::string value;
+        bool inValue = false;
+        for (size_t i = 1; i < tokens.size(); i++) {
+            if (tokens[i] == "name") {
+                inValue = false;
+            } else if (tokens[i] == "value") {
+                inValue = true;
+            } else {
+                std::string& target = inValue ? value : name;
+                if (!target.empty()) target += ' ';
+                target += tokens[i];
+            }
+        }
+        int number = std::atoi(value.c_str());
+        if (name == "Hash" && number > 0) {
+            table.resize(static_cast<size_t>(number));
+        } else if (name == "Threads" && number > 0) {
+            threadCount = number;
+            search.reset(new ParallelSearch(table, threadCount));
+        } else if (name == "BookFile") {
+            if (value.empty() || value == "<empty>") {
+                book.close();
+            } else if (!book.open(value)) {
+                output.send("info string cannot open book " + value + "\n");
+            }
+        }
+    }
+    
+    //position startpos|fen <fen> [moves <move>...]
+    void setPosition(const std::vector<std::string>& tokens) {
+        size_t i = 1;
+        if (i < tokens.size() && tokens[i] == "startpos") {
+            game.start();
+            i++;
+        } else if (i < tokens.size() && tokens[i] == "fen") {
+            std::string fen;
+            for (i++; i < tokens.size() && tokens[i] != "moves"; i++) {
+                if (!fen.empty()) fen += ' ';
+                fen += tokens[i];
+            }
+            if (!game.loadFEN(fen)) {
+                output.send("info string invalid fen " + fen + "\n");
+                return;
+            }
+        }
+        if (i < tokens.size() && tokens[i] == "moves") {
+            for (i++; i < tokens.size(); i++) {
+                Move move;
+                if (!game.getBoard().parseMove(tokens[i], move) || !game.makeMove(move)) {
+                    output.send("info string illegal move " + tokens[i] + "\n");
+                    return;
+                }
+            }
+        }
+    }
+    
+    //go [depth N] [movetime ms] [nodes N] [wtime ms btime ms winc ms binc ms movestogo N] [infinite]
+    void startSearch(const std::vector<std::string>& tokens) {
+        SearchLimits limits;
+        int64_t time[3] = { 0, 0, 0 };
+        int64_t increment[3] = { 0, 0, 0 };
+        int movesToGo = 0;
+        for (size_t i = 1; i + 1 < tokens.size(); i++) {
+            int64_t value = std::atoll(tokens[i + 1].c_str());
+            if (tokens[i] == "depth") limits.depth = static_cast<int>(value);
+            else if (tokens[i] == "movetime") limits.movetimeMs = value;
+            else if (tokens[i] == "nodes") limits.nodes = static_cast<uint64_t>(value);
+            else if (tokens[i] == "wtime") time[static_cast<int>(Color::WHITE)] = value;
+            else if (tokens[i] == "btime") time[static_cast<int>(Color::BLACK)] = value;
+            else if (tokens[i] == "winc") increment[static_cast<int>(Color::WHITE)] = value;
+            else if (tokens[i] == "binc") increment[static_cast<int>(Color::BLACK)] = value;
+            else if (tokens[i] == "movestogo") movesToGo = static_cast<int>(value);
+        }
+        limits.infinite = std::find(tokens.begin(), tokens.end(), "infinite") != tokens.end();
+        //clock play: an even share of the remaining time plus most of the increment
+        int side = static_cast<int>(game.getCurrentPlayer());
+        if (limits.movetimeMs == 0 && time[side] > 0) {
+            int64_t share = time[side] / (movesToGo > 0 ? movesToGo + 1 : 30) + increment[side] * 3 / 4;
+            limits.movetimeMs = std::max<int64_t>(1, std::min(share, time[side] - 50));
+        }
+        
+        //a book move is answered at once, without starting a search; under go infinite the
+        //protocol still wants bestmove only after stop
+        Move bookMove;
+        if (book.isOpen() && book.pickMove(game.getBoard(), random.rand64(), bookMove)) {
+            output.send("info string book move\n");
+            std::string reply = "bestmove " + bookMove.toString() + "\n";
+            if (limits.infinite) {
+                heldBestMove = reply;
+            } else {
+                output.send(reply);
+            }
+            return;
+        }
+        
+        ChessBoard root = game.getBoard();
+        std::vector<uint64_t> history = game.getPositionHistory();
+        search->onIteration = [this](const SearchResult& result) {
+            output.send(formatUciInfo(result, table.hashfull()));
+        };
+        searchThread = std::thread([this, root, history, limits] {
+            SearchResult result = search->search(root, limits, history);
+            std::string reply = "bestmove " + (result.hasMove ? result.bestMove.toString() : std::string("0000")) + "\n";
+            if (limits.infinite) {
+                heldBestMove = reply;
+            } else {
+                output.send(reply);
+            }
+        });
+    }
+    
+    //interrupt a running search; it still reports its best move, as the protocol requires
+    void stopSearch() {
+        if (searchThread.joinable()) {
+            search->stop();
+            searchThread.join();
+            search->resetStop();
+        }
+        if (!heldBestMove.empty()) {
+            output.send(heldBestMove);
+            heldBestMove.clear();
+        }
+    }
+};
+
+//log-linear latency histogram in nanoseconds: 16 buckets per power of two give about 6%
+//resolution, so percentiles cost a fixed 8 KB however many requests are recorded
+class LatencyHistogram {
+public:
+    static const int SUB_BUCKETS = 16;
+    static const int BUCKETS = 61 * SUB_BUCKETS;
+    
+    LatencyHistogram() {
+        clear();
+    }
+    
+    void clear() {
+        for (uint64_t& bucket : buckets) bucket = 0;
+        total = 0;
+    }
+    
+    void record(uint64_t nanoseconds) {
+        buckets[bucketOf(nanoseconds)]++;
+        total++;
+    }
+    
+    void merge(const LatencyHistogram& other) {
+        for (int i = 0; i < BUCKETS; i++) buckets[i] += other.buckets[i];
+        total += other.total;
+    }
+    
+    uint64_t count() const {
+        return total;
+    }
+    
+    //lower edge of the bucket holding the given percentile (0-100)
+    uint64_t percentile(double percent) const {
+        uint64_t rank = static_cast<uint64_t>(percent / 100.0 * total + 0.5);
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; i++) {
+            seen += buckets[i];
+            if (seen >= rank && seen > 0) return bucketValue(i);
+        }
+        return 0;
+    }
+    
+private:
+    static int bucketOf(uint64_t value) {
+        if (value < SUB_BUCKETS) return static_cast<int>(value);
+        int msb = 4;
+        while ((value >> (msb + 1)) != 0) msb++;
+        return (msb - 3) * SUB_BUCKETS + static_cast<int>((value >> (msb - 4)) & (SUB_BUCKETS - 1));
+    }
+    
+    static uint64_t bucketValue(int bucket) {
+        if (bucket < SUB_BUCKETS) return static_cast<uint64_t>(bucket);
+        int msb = bucket / SUB_BUCKETS + 3;
+        return static_cast<uint64_t>(SUB_BUCKETS + bucket % SUB_BUCKETS) << (msb - 4);
+    }
+    
+    uint64_t buckets[BUCKETS];
+    uint64_t total;
+};
+
+//pooled storage for the games of the session server. Games live in fixed chunks that never move,
+//closed slots go back on a free list with their vectors' capacity intact, and a generation per
+//slot turns the id of a closed session into an unknown one instead of a stranger's game.
+//A session id is the generation in the high 32 bits and the slot index in the low 32.
+class GameArena {
+public:
+    static const size_t CHUNK_SIZE = 1024;
+    static const size_t MAX_CHUNKS = 4096;
+    
+    struct Slot {
+        ChessGame game;
+        uint32_t generation;
+        bool live;
+        
+        Slot() : generation(0), live(false) {}
+    };
+    
+    GameArena() : slotsUsed(0) {
+        for (auto& chunk : chunks) chunk.store(nullptr, std::memory_order_relaxed);
+    }
+    
+    ~GameArena() {
+        for (auto& chunk : chunks) delete[] chunk.load(std::memory_order_relaxed);
+    }
+    
+    GameArena(const GameArena&) = delete;
+    GameArena& operator=(const GameArena&) = delete;
+    
+    //a free slot for a new session; false when the arena is full
+    bool allocate(uint64_t& id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint32_t index;
+        if (!freeSlots.empty()) {
+            index = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            if (slotsUsed == CHUNK_SIZE * MAX_CHUNKS) return false;
+            index = static_cast<uint32_t>(slotsUsed++);
+            if (index % CHUNK_SIZE == 0) {
+                chunks[index / CHUNK_SIZE].store(new Slot[CHUNK_SIZE], std::memory_order_release);
+            }
+        }
+        id = (static_cast<uint64_t>(slot(index)->generation) << 32) | index;
+        return true;
+    }
+    
+    //called by the owning worker once the session is closed or failed to start
+    void release(uint64_t id) {
+        Slot* closed = slot(slotIndex(id));
+        closed->live = false;
+        closed->generation++;
+        std::lock_guard<std::mutex> lock(mutex);
+        freeSlots.push_back(slotIndex(id));
+    }
+    
+    Slot* slot(uint32_t index) const {
+        Slot* chunk = chunks[index / CHUNK_SIZE].load(std::memory_order_acquire);
+        return chunk ? &chunk[index % CHUNK_SIZE] : nullptr;
+    }
+    
+    //the live session behind id, or nullptr; only the session's own worker may call this
+    Slot* find(uint64_t id) const {
+        if (slotIndex(id) >= CHUNK_SIZE * MAX_CHUNKS) return nullptr;
+        Slot* found = slot(slotIndex(id));
+        if (!found || !found->live || found->generation != static_cast<uint32_t>(id >> 32)) return nullptr;
+        return found;
+    }
+    
+    static uint32_t slotIndex(uint64_t id) {
+        return static_cast<uint32_t>(id);
+    }
+    
+private:
+    std::mutex mutex;
+    std::atomic<Slot*> chunks[MAX_CHUNKS];
+    size_t slotsUsed;
+    std::vector<uint32_t> freeSlots;
+};
+
+enum class SessionCommand : uint8_t {
+    NEW, MOVE, MOVES, STATE, FEN, CLOSE, STATS
+};
+
+static const int TIMED_SESSION_COMMANDS = 6; //every command but STATS
+static const char* const sessionCommandNames[] = { "new", "move", "moves", "state", "fen", "close", "stats" };
+
+typedef std::function<void(const std::string&)> ReplySink;
+
+//a "stats" request visits every worker; the last one to add its histograms sends the report
+struct StatsCollection {
+    std::mutex mutex;
+    LatencyHistogram latency[TIMED_SESSION_COMMANDS];
+    int remaining;
+    std::shared_ptr<const ReplySink> reply;
+};
+
+struct SessionRequest {
+    SessionCommand command;
+    uint64_t session;
+    std::string argument;
+    std::shared_ptr<const ReplySink> reply;
+    std::shared_ptr<StatsCollection> stats;
+    std::chrono::steady_clock::time_point received;
+};
+
+//hosts many games behind a line protocol, one request per line:
+//  new [fen]          -> "<id> ok new <state>"
+//  move <id> <move>   -> "<id> ok move <state>"
+//  moves <id>         -> "<id> ok moves <move> ..."
+//  state <id>         -> "<id> ok state <state>"
+//  fen <id>           -> "<id> ok fen <fen>"
+//  close <id>         -> "<id> ok close"
+//  stats              -> one "stats <command> count <n> p50 <us> p99 <us>" line per command
+//Failures answer "<id> error <command> <reason>". Every session belongs to one worker thread
+//(slot index modulo the worker count) and only that thread touches its game, so boards need no
+//locks and a session's replies come back in request order. Workers are plain threads rather than
+//the work-stealing ThreadPool, which would break that ownership.
+class SessionServer {
+public:
+    explicit SessionServer(int workerCount) {
+        if (workerCount < 1) workerCount = 1;
+        for (int i = 0; i < workerCount; i++) {
+            workers.push_back(std::unique_ptr<Worker>(new Worker()));
+        }
+        for (int i = 0; i < workerCount; i++) {
+            workers[i]->thread = std::thread([this, i] { workerLoop(*workers[i]); });
+        }
+    }
+    
+    ~SessionServer() {
+        stop();
+    }
+    
+    //parse one request line and queue it with its owning worker; safe from any thread, including
+    //a reply sink. Returns false for "quit".
+    bool submit(std::string_view line, const std::shared_ptr<const ReplySink>& reply) {
+        auto received = std::chrono::steady_clock::now();
+        std::string_view word = nextWord(line);
+        if (word.empty()) return true;
+        if (word == "quit") return false;
+        
+        SessionRequest request;
+        request.reply = reply;
+        request.received = received;
+        if (word == "stats") {
+            request.command = SessionCommand::STATS;
+            request.session = 0;
+            request.stats = std::make_shared<StatsCollection>();
+            request.stats->remaining = static_cast<int>(workers.size());
+            request.stats->reply = reply;
+            for (auto& worker : workers) enqueue(*worker, request);
+            return true;
+        }
+        
+        int command = 0;
+        while (command < TIMED_SESSION_COMMANDS && word != sessionCommandNames[command]) command++;
+        if (command == TIMED_SESSION_COMMANDS) {
+            (*reply)("0 error " + std::string(word) + " unknown command\n");
+            return true;
+        }
+        request.command = static_cast<SessionCommand>(command);
+        if (request.command == SessionCommand::NEW) {
+            if (!arena.allocate(request.session)) {
+                (*reply)("0 error new too many sessions\n");
+                return true;
+            }
+        } else if (!parseId(nextWord(line), request.session)) {
+            (*reply)("0 error " + std::string(word) + " missing session id\n");
+            return true;
+        }
+        while (!line.empty() && line.front() == ' ') line.remove_prefix(1);
+        request.argument = std::string(line);
+        enqueue(*workers[GameArena::slotIndex(request.session) % workers.size()], std::move(request));
+        return true;
+    }
+    
+    //finish every queued request, then stop the workers
+    void stop() {
+        for (auto& worker : workers) {
+            {
+                std::lock_guard<std::mutex> lock(worker->mutex);
+                worker->stopping = true;
+            }
+            worker->ready.notify_one();
+        }
+        for (auto& worker : workers) {
+            if (worker->thread.joinable()) worker->thread.join();
+        }
+    }
+    
+    //per-command latency summed over the workers; only valid once stop() has returned
+    std::string latencyReport() const {
+        LatencyHistogram latency[TIMED_SESSION_COMMANDS];
+        for (const auto& worker : workers) {
+            for (int i = 0; i < TIMED_SESSION_COMMANDS; i++) latency[i].merge(worker->latency[i]);
+        }
+        return formatLatency(latency);
+    }
+    
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<SessionRequest> queue;
+        bool stopping;
+        std::thread thread;
+        LatencyHistogram latency[TIMED_SESSION_COMMANDS];
+        
+        Worker() : stopping(false) {}
+    };
+    
+    GameArena arena;
+    std::vector<std::unique_ptr<Worker>> workers;
+    
+    static std::string_view nextWord(std::string_view& text) {
+        while (!text.empty() && text.front() == ' ') text.remove_prefix(1);
+        size_t end = std::min(text.find(' '), text.size());
+        std::string_view word = text.substr(0, end);
+        text.remove_prefix(end);
+        return word;
+    }
+    
+    static bool parseId(std::string_view text, uint64_t& id) {
+        if (text.empty() || text.size() > 20) return false;
+        id = 0;
+        for (char c : text) {
+            if (!std::isdigit(static_cast<unsigned char>(c))) return false;
+            id = id * 10 + static_cast<uint64_t>(c - '0');
+        }
+        return true;
+    }
+    
+    static std::string formatMicroseconds(uint64_t nanoseconds) {
+        return std::to_string(nanoseconds / 1000) + "." + std::to_string(nanoseconds % 1000 / 100);
+    }
+    
+    static std::string formatLatency(const LatencyHistogram* latency) {
+        std::string report;
+        for (int i = 0; i < TIMED_SESSION_COMMANDS; i++) {
+            report += "stats ";
+            report += sessionCommandNames[i];
+            report += " count " + std::to_string(latency[i].count()) +
+                      " p50 " + formatMicroseconds(latency[i].percentile(50)) +
+                      " us p99 " + formatMicroseconds(latency[i].percentile(99)) + " us\n";
+        }
+        return report;
+    }
+    
+    void enqueue(Worker& worker, SessionRequest request) {
+        {
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            worker.queue.push_back(std::move(request));
+        }
+        worker.ready.notify_one();
+    }
+    
+    //takes the whole queue at once so a busy worker locks once per batch, not once per request
+    void workerLoop(Worker& worker) {
+        std::deque<SessionRequest> batch;
+        std::string reply;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(worker.mutex);
+                worker.ready.wait(lock, [&worker] { return worker.stopping || !worker.queue.empty(); });
+                if (worker.queue.empty()) return;
+                batch.swap(worker.queue);
+            }
+            for (SessionRequest& request : batch) {
+                if (request.command == SessionCommand::STATS) {
+                    addStats(worker, *request.stats);
+                    continue;
+                }
+                handle(request, reply);
+                auto elapsed = std::chrono::steady_clock::now() - request.received;
+                worker.latency[static_cast<int>(request.command)].record(
+                    static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+                (*request.reply)(reply);
+            }
+            batch.clear();
+        }
+    }
+    
+    void handle(const SessionRequest& request, std::string& reply) {
+        const char* name = sessionCommandNames[static_cast<int>(request.command)];
+        reply = std::to_string(request.session);
+        if (request.command == SessionCommand::NEW) {
+            GameArena::Slot* slot = arena.slot(GameArena::slotIndex(request.session));
+            slot->game.start();
+            if (!request.argument.empty() && !slot->game.loadFEN(request.argument)) {
+                arena.release(request.session);
+                reply += " error new invalid FEN\n";
+                return;
+            }
+            slot->live = true;
+            reply += " ok new " + slot->game.getResult() + "\n";
+            return;
+        }
+        
+        GameArena::Slot* slot = arena.find(request.session);
+        if (!slot) {
+            reply += std::string(" error ") + name + " unknown session\n";
+            return;
+        }
+        ChessGame& game = slot->game;
+        reply += std::string(" ok ") + name;
+        switch (request.command) {
+            case SessionCommand::MOVE: {
+                Move move;
+                if (!game.getBoard().parseMove(request.argument, move) || !game.makeMove(move)) {
+                    reply = std::to_string(request.session) + " error move illegal move " + request.argument;
+                    break;
+                }
+                reply += ' ';
+                reply += game.getResult();
+                break;
+            }
+            case SessionCommand::MOVES:
+                for (const Move& move : game.getLegalMoves()) {
+                    reply += ' ';
+                    reply += move.toString();
+                }
+                break;
+            case SessionCommand::STATE:
+                reply += ' ';
+                reply += game.getResult();
+                break;
+            case SessionCommand::FEN:
+                reply += ' ';
+                reply += game.getFEN();
+                break;
+            case SessionCommand::CLOSE:
+                arena.release(request.session);
+                break;
+            default:
+                break;
+        }
+        reply += '\n';
+    }
+    
+    void addStats(Worker& worker, StatsCollection& stats) {
+        std::lock_guard<std::mutex> lock(stats.mutex);
+        for (int i = 0; i < TIMED_SESSION_COMMANDS; i++) stats.latency[i].merge(worker.latency[i]);
+        if (--stats.remaining == 0) {
+            (*stats.reply)(formatLatency(stats.latency));
+        }
+    }
+};
+
+//line-delimited requests on stdin, replies on stdout; the latency summary goes to stderr at the end
+int runSessionServer(int threads) {
+    SessionServer server(threads);
+    std::mutex outputMutex;
+    auto reply = std::make_shared<const ReplySink>([&outputMutex](const std::string& message) {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        std::cout.write(message.data(), static_cast<std::streamsize>(message.size()));
+        std::cout.flush();
+    });
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!server.submit(line, reply)) break;
+    }
+    server.stop();
+    std::cerr << server.latencyReport();
+    return 0;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+//the same protocol on a listening socket (TCP on loopback or a Unix socket), one reader thread per
+//connection; "quit" from any client shuts the server down
+int runSessionSocketServer(int listenFd, int threads) {
+    SessionServer server(threads);
+    std::mutex connectionsMutex;
+    std::vector<int> connections;
+    std::vector<std::thread> readers;
+    std::atomic<bool> quitting(false);
+    
+    while (!quitting) {
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) break;
+        {
+            std::lock_guard<std::mutex> lock(connectionsMutex);
+            connections.push_back(fd);
+        }
+        readers.emplace_back([&, fd] {
+            //the sink owns the descriptor, so it is closed once the last queued reply is written
+            auto writeMutex = std::make_shared<std::mutex>();
+            std::shared_ptr<int> socket(new int(fd), [](int* owned) { ::close(*owned); delete owned; });
+            auto reply = std::make_shared<const ReplySink>([socket, writeMutex](const std::string& message) {
+                std::lock_guard<std::mutex> lock(*writeMutex);
+                size_t sent = 0;
+                while (sent < message.size()) {
+                    ssize_t n = ::write(*socket, message.data() + sent, message.size() - sent);
+                    if (n <= 0) return;
+                    sent += static_cast<size_t>(n);
+                }
+            });
+            std::string pending;
+            char buffer[4096];
+            ssize_t n;
+            bool quit = false;
+            while (!quit && (n = ::read(fd, buffer, sizeof(buffer))) > 0) {
+                pending.append(buffer, static_cast<size_t>(n));
+                size_t start = 0;
+                size_t end;
+                while (!quit && (end = pending.find('\n', start)) != std::string::npos) {
+                    std::string_view line(pending.data() + start, end - start);
+                    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+                    start = end + 1;
+                    quit = !server.submit(line, reply);
+                }
+                pending.erase(0, start);
+            }
+            {
+                std::lock_guard<std::mutex> lock(connectionsMutex);
+                connections.erase(std::find(connections.begin(), connections.end(), fd));
+            }
+            if (quit) {
+                quitting = true;
+                ::shutdown(listenFd, SHUT_RDWR);
+            }
+        });
+    }
+    
+    //unblock the readers of idle clients, then let the workers drain
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        for (int fd : connections) ::shutdown(fd, SHUT_RD);
+    }
+    for (auto& reader : readers) reader.join();
+    server.stop();
+    std::cerr << server.latencyReport();
+    return 0;
+}
+
+int runSessionTcpServer(int port, int threads) {
+    int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int enable = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    if (listenFd < 0 || bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listenFd, 64) != 0) {
+        std::cout << "Cannot listen on 127.0.0.1:" << port << std::endl;
+        if (listenFd >= 0) ::close(listenFd);
+        return 1;
+    }
+    std::cout << "Listening on 127.0.0.1:" << port << std::endl;
+    int status = runSessionSocketServer(listenFd, threads);
+    ::close(listenFd);
+    return status;
+}
+
+int runSessionUnixServer(const std::string& path, int threads) {
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cout << "Socket path too long: " << path << std::endl;
+        return 1;
+    }
+    path.copy(address.sun_path, path.size());
+    ::unlink(path.c_str());
+    if (listenFd < 0 || bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listenFd, 64) != 0) {
+        std::cout << "Cannot listen on " << path << std::endl;
+        if (listenFd >= 0) ::close(listenFd);
+        return 1;
+    }
+    std::cout << "Listening on " << path << std::endl;
+    int status = runSessionSocketServer(listenFd, threads);
+    ::close(listenFd);
+    ::unlink(path.c_str());
+    return status;
+}
+#endif
+
+//in-process stand-in for socket clients: keeps `sessions` random games going through the full text
+//protocol (new, moves, move, state, ... close, new) until `requests` requests have been sent,
+//then prints throughput and the latency per command
+int runSessionLoopback(int sessions, int64_t requests, int threads) {
+    static const int MAX_PLIES = 200;
+    struct ClientSession {
+        uint64_t random;
+        int plies;
+    };
+    
+    SessionServer server(threads);
+    //replies for a slot always come from the worker owning it, so this needs no lock
+    std::vector<ClientSession> clients(sessions);
+    for (int i = 0; i < sessions; i++) clients[i] = ClientSession{ 0x9E3779B97F4A7C15ULL * (i + 1), 0 };
+    std::atomic<int64_t> budget(requests);
+    std::atomic<int64_t> outstanding(0);
+    std::atomic<uint64_t> errors(0);
+    std::mutex doneMutex;
+    std::condition_variable done;
+    std::shared_ptr<const ReplySink> reply;
+    
+    auto send = [&](const std::string& line) {
+        if (budget.fetch_sub(1) <= 0) return;
+        outstanding++;
+        server.submit(line, reply);
+    };
+    reply = std::make_shared<const ReplySink>([&](const std::string& message) {
+        std::string_view text(message.data(), message.size() - 1);
+        size_t space = text.find(' ');
+        std::string id(text.substr(0, space));
+        text.remove_prefix(space + 1);
+        ClientSession& client = clients[GameArena::slotIndex(std::stoull(id))];
+        if (text.compare(0, 3, "ok ") != 0) {
+            errors++;
+        } else if (text.compare(3, 4, "new ") == 0 || text.compare(3, 5, "state") == 0) {
+            send("moves " + id);
+        } else if (text.compare(3, 5, "moves") == 0) {
+            std::vector<std::string_view> moves;
+            text.remove_prefix(8);
+            while (!text.empty()) {
+                while (!text.empty() && text.front() == ' ') text.remove_prefix(1);
+                size_t end = std::min(text.find(' '), text.size());
+                if (end > 0) moves.push_back(text.substr(0, end));
+                text.remove_prefix(end);
+            }
+            if (moves.empty() || client.plies >= MAX_PLIES) {
+                send("close " + id);
+            } else {
+                client.random ^= client.random << 13;
+                client.random ^= client.random >> 7;
+                client.random ^= client.random << 17;
+                client.plies++;
+                send("move " + id + " " + std::string(moves[client.random % moves.size()]));
+            }
+        } else if (text.compare(3, 4, "move") == 0) {
+            send("state " + id);
+        } else if (text.compare(3, 5, "close") == 0) {
+            client.plies = 0;
+            send("new");
+        }
+        if (--outstanding == 0) {
+            std::lock_guard<std::mutex> lock(doneMutex);
+            done.notify_all();
+        }
+    });
+    
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < sessions; i++) send("new");
+    {
+        std::unique_lock<std::mutex> lock(doneMutex);
+        done.wait(lock, [&] { return outstanding == 0; });
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    server.stop();
+    
+    int64_t handled = requests - std::max<int64_t>(budget, 0);
+    std::cout << handled << " requests over " << sessions << " sessions in " << seconds << " s, "
+              << static_cast<uint64_t>(handled / (seconds > 0 ? seconds : 1e-9)) << " requests/s with "
+              << threads << " worker(s), " << errors << " error(s)" << std::endl;
+    std::cout << server.latencyReport();
+    return errors == 0 ? 0 : 1;
+}
+
+//main function
+//  (no arguments)           interactive game
+//  fen <fen>                interactive game from a position
+//  play [white|black] [movetime ms] [book]
+//                           play one side against the engine (default: human white, 1000 ms)
+//  selfplay [movetime ms] [max plies] [book]
+//                           engine against engine, reporting node throughput
+//  perft [depth]            reference suite up to depth (default 4), exit code 1 on a mismatch
+//  perft <depth> <fen>      node count for one position
+//  divide <depth> [fen]     node count per root move
+//  pperft <depth> [threads] [fen]
+//                           parallel perft scaling from 1 to threads workers (default: all cores)
+//  smp <depth> [threads] [fen]
+//                           Lazy SMP time-to-depth and nps scaling from 1 to threads (default: all cores)
+//  uci                      Universal Chess Interface on stdin/stdout for GUIs and tournament managers
+//  batch <file> [depth] [threads]
+//                           search every FEN/EPD line of file, one result line each (default: depth 4, all cores)
+//  server [stdin|tcp|unix|loopback] ...
+//                           multi-session game server: stdin [threads], tcp [port] [threads],
+//                           unix [path] [threads] or loopback [sessions] [requests] [threads] benchmark
+//  records write <file> [games] [maxPlies] [raw] | records read <file> | records pgn <file>
+//                           write random games to a game record archive, replay one, or print it as PGN
+//  pgn <file> [archive|-] [threads] [raw]
+//                           import a PGN file, optionally into an archive, reporting games and MB per second
+//  index build <index> <archive> [threads] [memoryMB] [maxPly] | index probe <index> [fen]
+//                           build a position index from an archive, or show the statistics of a position
+//  book build <archive|pgn> <book> [maxPly] [minGames] | book probe <book> [fen]
+//                           build a Polyglot opening book from a game collection, or list a position's book moves
+int main(int argc, char* argv[]) {
+    std::string mode = (argc > 1) ? argv[1] : "";
+    
+    if (mode == "uci") {
+        std::ios::sync_with_stdio(false);
+        UciSession session;
+        return session.run();
+    }
+    
+    if (mode == "pperft") {
+        int depth = (argc > 2) ? std::atoi(argv[2]) : 6;
+        int threads = (argc > 3) ? std::atoi(argv[3]) : static_cast<int>(std::thread::hardware_concurrency());
+        std::string fen = joinArguments(argc, argv, 4);
+        ChessBoard board;
+        if (!fen.empty() && !board.fromFEN(fen)) {
+            std::cout << "Invalid FEN: " << fen << std::endl;
+            return 1;
+        }
+        return runParallelPerftScaling(board, depth, threads > 0 ? threads : 1) ? 0 : 1;
+    }
+    
+    if (mode == "smp") {
+        int depth = (argc > 2) ? std::atoi(argv[2]) : 8;
+        int threads = (argc > 3) ? std::atoi(argv[3]) : static_cast<int>(std::thread::hardware_concurrency());
+        std::string fen = joinArguments(argc, argv, 4);
+        ChessBoard board;
+        if (!fen.empty() && !board.fromFEN(fen)) {
+            std::cout << "Invalid FEN: " << fen << std::endl;
+            return 1;
+        }
+        runSearchScaling(board, depth, threads > 0 ? threads : 1, 64);
+        return 0;
+    }
+    
+    if (mode == "server") {
+        std::string transport = (argc > 2) ? argv[2] : "stdin";
+        int hardwareThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+        if (transport == "loopback") {
+            int sessions = (argc > 3) ? std::atoi(argv[3]) : 1000;
+            int64_t requests = (argc > 4) ? std::atoll(argv[4]) : 1000000;
+            int threads = (argc > 5) ? std::atoi(argv[5]) : hardwareThreads;
+            return runSessionLoopback(std::max(1, sessions), requests, std::max(1, threads));
+        }
+#if defined(__unix__) || defined(__APPLE__)
+        if (transport == "tcp") {
+            int port = (argc > 3) ? std::atoi(argv[3]) : 7070;
+            int threads = (argc > 4) ? std::atoi(argv[4]) : hardwareThreads;
+            return runSessionTcpServer(port, std::max(1, threads));
+        }
+        if (transport == "unix") {
+            std::string path = (argc > 3) ? argv[3] : "/tmp/chess-sessions.sock";
+            int threads = (argc > 4) ? std::atoi(argv[4]) : hardwareThreads;
+            return runSessionUnixServer(path, std::max(1, threads));
+        }
+#endif
+        if (transport != "stdin") {
+            std::cout << "Usage: server [stdin [threads] | tcp [port] [threads] | unix [path] [threads] | "
+                         "loopback [sessions] [requests] [threads]]" << std::endl;
+            return 1;
+        }
+        std::ios::sync_with_stdio(false);
+        int threads = (argc > 3) ? std::atoi(argv[3]) : hardwareThreads;
+        return runSessionServer(std::max(1, threads));
+    }
+    
+    if (mode == "records") {
+        std::string action = (argc > 2) ? argv[2] : "";
+        if (action == "write" && argc > 3) {
+            int games = (argc > 4) ? std::atoi(argv[4]) : 1000;
+            int maxPlies = (argc > 5) ? std::atoi(argv[5]) : 300;
+            bool rankCoded = !(argc > 6 && std::string(argv[6]) == "raw");
+            return writeRandomGameRecords(argv[3], games, maxPlies, rankCoded) ? 0 : 1;
+        }
+        if (action == "read" && argc > 3) {
+            return replayGameRecords(argv[3]) ? 0 : 1;
+        }
+        if (action == "pgn" && argc > 3) {
+            std::ios::sync_with_stdio(false);
+            return exportGameRecordsAsPgn(argv[3]) ? 0 : 1;
+        }
+        std::cout << "Usage: records write <file> [games] [maxPlies] [raw] | records read <file> | records pgn <file>"
+                  << std::endl;
+        return 1;
+    }
+    
+    if (mode == "pgn") {
+        if (argc < 3) {
+            std::cout << "Usage: pgn <file> [archive|-] [threads] [raw]" << std::endl;
+            return 1;
+        }
+        std::string archive = (argc > 3) ? argv[3] : "-";
+        int threads = (argc > 4) ? std::atoi(argv[4]) : static_cast<int>(std::thread::hardware_concurrency());
+        GameRecordWriter writer;
+        if (archive != "-" && !writer.open(archive, !(argc > 5 && std::string(argv[5]) == "raw"))) {
+            std::cout << "Cannot write " << archive << std::endl;
+            return 1;
+        }
+        PgnImportStats stats;
+        if (!importPgn(argv[2], threads > 0 ? threads : 1, (archive != "-") ? &writer : nullptr, nullptr, stats) ||
+            (archive != "-" && !writer.close())) {
+            std::cout << "Import of " << argv[2] << " failed" << std::endl;
+            return 1;
+        }
+        double seconds = stats.seconds > 0 ? stats.seconds : 1e-9;
+        std::cout << stats.games << " games (" << stats.errors << " rejected), " << stats.plies << " plies in "
+                  << stats.seconds << " s: " << static_cast<uint64_t>(stats.games / seconds) << " games/s, "
+                  << stats.bytes / seconds / (1024 * 1024) << " MB/s" << std::endl;
+        return stats.errors == 0 ? 0 : 1;
+    }
+    
+    if (mode == "book") {
+        std::string action = (argc > 2) ? argv[2] : "";
+        if (action == "build" && argc > 4) {
+            int maxPly = (argc > 5) ? std::atoi(argv[5]) : 20;
+            int minGames = (argc > 6) ? std::atoi(argv[6]) : 1;
+            return buildPolyglotBook(argv[3], argv[4], maxPly, minGames) ? 0 : 1;
+        }
+        if (action == "probe" && argc > 3) {
+            return probePolyglotBook(argv[3], joinArguments(argc, argv, 4)) ? 0 : 1;
+        }
+        std::cout << "Usage: book build <archive|pgn> <book> [maxPly] [minGames] | book probe <book> [fen]" << std::endl;
+        return 1;
+    }
+    
+    if (mode == "index") {
+        std::string action = (argc > 2) ? argv[2] : "";
+        if (action == "build" && argc > 4) {
+            int threads = (argc > 5) ? std::atoi(argv[5]) : static_cast<int>(std::thread::hardware_concurrency());
+            size_t memoryMegabytes = (argc > 6) ? static_cast<size_t>(std::max(1, std::atoi(argv[6]))) : 256;
+            int maxPly = (argc > 7) ? std::atoi(argv[7]) : 0;
+            auto start = std::chrono::steady_clock::now();
+            PositionIndexBuilder builder(argv[3], threads > 0 ? threads : 1, memoryMegabytes, maxPly);
+            if (!builder.addArchive(argv[4]) || !builder.finish()) {
+                std::cout << "Building " << argv[3] << " from " << argv[4] << " failed" << std::endl;
+                return 1;
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << builder.gameCount() << " games, " << builder.positionCount() << " positions, "
+                      << builder.uniquePositionCount() << " unique, " << builder.runCount() << " spilled run(s) in "
+                      << seconds << " s, " << static_cast<uint64_t>(builder.positionCount() / (seconds > 0 ? seconds : 1e-9))
+                      << " positions/s" << std::endl;
+            return 0;
+        }
+        if (action == "probe" && argc > 3) {
+            return probePositionIndex(argv[3], joinArguments(argc, argv, 4)) ? 0 : 1;
+        }
+        std::cout << "Usage: index build <index> <archive> [threads] [memoryMB] [maxPly] | index probe <index> [fen]"
+                  << std::endl;
+        return 1;
+    }
+    
+    if (mode == "batch") {
+        if (argc < 3) {
+            std::cout << "Usage: batch <file> [depth] [threads]" << std::endl;
+            return 1;
+        }
+        std::ios::sync_with_stdio(false);
+        int depth = (argc > 3) ? std::atoi(argv[3]) : 4;
+        int threads = (argc > 4) ? std::atoi(argv[4]) : static_cast<int>(std::thread::hardware_concurrency());
+        return runBatchAnalysis(argv[2], depth, threads > 0 ? threads : 1) ? 0 : 1;
+    }
+    
+    if (mode == "perft" || mode == "divide") {
+        int depth = (argc > 2) ? std::atoi(argv[2]) : 4;
+        std::string fen = joinArguments(argc, argv, 3);
+        if (mode == "perft" && fen.empty()) {
+            bool perftPassed = runPerftSuite(depth);
+            return (checkPolyglotKeys() && perftPassed) ? 0 : 1;
+        }
+        ChessBoard board;
+        if (!fen.empty() && !board.fromFEN(fen)) {
+            std::cout << "Invalid FEN: " << fen << std::endl;
+            return 1;
+        }
+        auto start = std::chrono::steady_clock::now();
+        uint64_t nodes = (mode == "divide") ? board.divide(depth) : board.perft(depth);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "perft " << depth << ": " << nodes << " nodes in " << seconds << " s, "
+                  << static_cast<uint64_t>(nodes / (seconds > 0 ? seconds : 1e-9)) << " nps" << std::endl;
+        return 0;
+    }
+    
+    if (mode == "fen") {
+        return runInteractive(joinArguments(argc, argv, 2), Color::NONE, SearchLimits());
+    }
+    
+    if (mode == "play") {
+        std::string side = (argc > 2) ? argv[2] : "white";
+        SearchLimits limits;
+        limits.movetimeMs = (argc > 3) ? std::atoi(argv[3]) : 1000;
+        PolyglotBook book;
+        if (argc > 4 && !book.open(argv[4])) {
+            std::cout << "Not a Polyglot book: " << argv[4] << std::endl;
+            return 1;
+        }
+        return runInteractive("", (side == "black") ? Color::WHITE : Color::BLACK, limits,
+                              book.isOpen() ? &book : nullptr);
+    }
+    
+    if (mode == "selfplay") {
+        SearchLimits limits;
+        limits.movetimeMs = (argc > 2) ? std::atoi(argv[2]) : 200;
+        PolyglotBook book;
+        if (argc > 4 && !book.open(argv[4])) {
+            std::cout << "Not a Polyglot book: " << argv[4] << std::endl;
+            return 1;
+        }
+        return runSelfPlay(limits, (argc > 3) ? std::atoi(argv[3]) : 400, book.isOpen() ? &book : nullptr);
+    }
+    
+    return runInteractive("", Color::NONE, SearchLimits());
+}